@@ -0,0 +1,425 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <alsaplusplus/channel_matrix.hpp>
+#include <alsaplusplus/convert.hpp>
+#include <alsaplusplus/gain.hpp>
+#include <alsaplusplus/mock_backend.hpp>
+#include <alsaplusplus/pcm.hpp>
+#include <alsaplusplus/resampler.hpp>
+
+using namespace AlsaPlusPlus;
+
+// Microbenchmarks for the playback hot path. Every case processes one
+// period per iteration and reports frames/second and ns/period as JSON.
+// Device cases run against the bench_null and bench_file PCMs defined in
+// bench/asoundrc.in; if a device can't be opened the case is reported as
+// skipped rather than failing the run. The pcm/mock cases use an in-memory
+// MockBackend instead, so they measure only the library's own overhead and
+// run the same on any machine.
+
+static const snd_pcm_uframes_t PERIOD_FRAMES = 1024;
+static const unsigned int SAMPLE_RATE = 48000;
+
+struct BenchResult
+{
+  std::string name;
+  std::string status; // "ok", "skipped" or "failed"
+  snd_pcm_uframes_t period_frames;
+  uint64_t periods;
+  double seconds;
+};
+
+struct BenchOptions
+{
+  std::string null_device = "bench_null";
+  std::string file_device = "bench_file";
+  double seconds = 0.5;
+  std::string output_path;
+};
+
+// Runs body once per period until min_seconds have passed, after a short
+// warm-up. body returns false to abort the case.
+BenchResult run_case(const std::string& name, snd_pcm_uframes_t period_frames, double min_seconds, std::function<bool()> body)
+{
+  BenchResult result = {name, "ok", period_frames, 0, 0.0};
+
+  for (int i = 0; i < 16; i++)
+  {
+    if (!body())
+    {
+      result.status = "failed";
+      return result;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto now = start;
+
+  do
+  {
+    for (int i = 0; i < 16; i++)
+    {
+      if (!body())
+      {
+        result.status = "failed";
+        return result;
+      }
+    }
+
+    result.periods += 16;
+    now = std::chrono::steady_clock::now();
+  } while (std::chrono::duration<double>(now - start).count() < min_seconds);
+
+  result.seconds = std::chrono::duration<double>(now - start).count();
+
+  return result;
+}
+
+BenchResult skipped(const std::string& name)
+{
+  return {name, "skipped", PERIOD_FRAMES, 0, 0.0};
+}
+
+std::vector<float> test_signal(unsigned int channels)
+{
+  std::vector<float> samples(PERIOD_FRAMES * channels);
+
+  for (size_t i = 0; i < samples.size(); i++)
+    samples[i] = 0.8f * std::sin(0.01f * static_cast<float>(i));
+
+  return samples;
+}
+
+void bench_conversion(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+  const unsigned int channels = 2;
+  const size_t samples = PERIOD_FRAMES * channels;
+  std::vector<float> source = test_signal(channels);
+  std::vector<float> floats(samples);
+  std::vector<char> device(samples * 4);
+  DitherState dither;
+
+  struct FormatCase
+  {
+    snd_pcm_format_t format;
+    const char* name;
+  };
+
+  const FormatCase formats[] = {
+    {SND_PCM_FORMAT_U8, "u8"},
+    {SND_PCM_FORMAT_S16_LE, "s16_le"},
+    {SND_PCM_FORMAT_S24_LE, "s24_le"},
+    {SND_PCM_FORMAT_S24_3LE, "s24_3le"},
+    {SND_PCM_FORMAT_S32_LE, "s32_le"},
+    {SND_PCM_FORMAT_FLOAT_LE, "float_le"}
+  };
+
+  for (const FormatCase& format : formats)
+  {
+    results.push_back(run_case(std::string("convert/float_to_") + format.name, PERIOD_FRAMES, options.seconds, [&]()
+    {
+      return convert_from_float(source.data(), device.data(), format.format, samples) == 0;
+    }));
+
+    results.push_back(run_case(std::string("convert/float_to_") + format.name + "_dither", PERIOD_FRAMES, options.seconds, [&]()
+    {
+      return convert_from_float(source.data(), device.data(), format.format, samples, &dither) == 0;
+    }));
+
+    results.push_back(run_case(std::string("convert/") + format.name + "_to_float", PERIOD_FRAMES, options.seconds, [&]()
+    {
+      return convert_to_float(device.data(), floats.data(), format.format, samples) == 0;
+    }));
+  }
+}
+
+void bench_mixing(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+  struct MixCase
+  {
+    AudioChannels input;
+    AudioChannels output;
+    const char* name;
+  };
+
+  const MixCase mixes[] = {
+    {AudioChannels::FULL_SURROUND_PLUS_SUB, AudioChannels::STEREO, "mix/5.1_to_stereo"},
+    {AudioChannels::STEREO, AudioChannels::FULL_SURROUND_PLUS_SUB, "mix/stereo_to_5.1"},
+    {AudioChannels::STEREO, AudioChannels::MONO, "mix/stereo_to_mono"},
+    {AudioChannels::MONO, AudioChannels::STEREO, "mix/mono_to_stereo"}
+  };
+
+  for (const MixCase& mix : mixes)
+  {
+    ChannelMatrix matrix = ChannelMatrix::preset(mix.input, mix.output);
+    std::vector<float> input = test_signal(matrix.input_channels());
+    std::vector<float> output(PERIOD_FRAMES * matrix.output_channels());
+
+    results.push_back(run_case(mix.name, PERIOD_FRAMES, options.seconds, [&]()
+    {
+      matrix.apply(input.data(), output.data(), PERIOD_FRAMES);
+      return true;
+    }));
+  }
+}
+
+void bench_resampling(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+  struct ResampleCase
+  {
+    ResamplerQuality quality;
+    unsigned int input_rate;
+    const char* name;
+  };
+
+  const ResampleCase cases[] = {
+    {ResamplerQuality::FAST, 44100, "resample/44100_to_48000_fast"},
+    {ResamplerQuality::MEDIUM, 44100, "resample/44100_to_48000_medium"},
+    {ResamplerQuality::HIGH, 44100, "resample/44100_to_48000_high"},
+    {ResamplerQuality::MEDIUM, 96000, "resample/96000_to_48000_medium"}
+  };
+
+  const unsigned int channels = 2;
+  std::vector<float> input = test_signal(channels);
+
+  for (const ResampleCase& test : cases)
+  {
+    Resampler resampler;
+
+    if (resampler.configure(test.input_rate, SAMPLE_RATE, channels, test.quality, PERIOD_FRAMES) < 0)
+    {
+      results.push_back(skipped(test.name));
+      continue;
+    }
+
+    std::vector<float> output(resampler.max_output_frames(PERIOD_FRAMES) * channels);
+
+    results.push_back(run_case(test.name, PERIOD_FRAMES, options.seconds, [&]()
+    {
+      resampler.process(input.data(), PERIOD_FRAMES, output.data());
+      return true;
+    }));
+  }
+}
+
+void bench_gain(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+  const unsigned int channels = 2;
+  std::vector<float> input = test_signal(channels);
+  std::vector<float> output(input.size());
+
+  GainStage gain;
+  gain.set_target(0.5f, 0);
+
+  results.push_back(run_case("gain/settled", PERIOD_FRAMES, options.seconds, [&]()
+  {
+    gain.process(input.data(), output.data(), PERIOD_FRAMES, channels);
+    return true;
+  }));
+
+  GainStage limited;
+  limited.set_target(1.5f, 0);
+  limited.set_limiter(true);
+
+  results.push_back(run_case("gain/limiter", PERIOD_FRAMES, options.seconds, [&]()
+  {
+    limited.process(input.data(), output.data(), PERIOD_FRAMES, channels);
+    return true;
+  }));
+}
+
+typedef std::function<std::unique_ptr<PCMBackend>()> BackendFactory;
+
+// One device case: opens the PCM, configures one period of PERIOD_FRAMES
+// and runs body against it.
+void bench_device(const std::string& name, BackendFactory open_backend, snd_pcm_access_t access, snd_pcm_format_t format,
+  double seconds, std::vector<BenchResult>& results, std::function<bool(PCMPlayer&)> body)
+{
+  try
+  {
+    PCMPlayer player(open_backend());
+    HwParams params;
+
+    params.access_type = access;
+    params.format_type = format;
+    params.sample_rate_hz = SAMPLE_RATE;
+    params.channels = AudioChannels::STEREO;
+    params.period_time_us = static_cast<unsigned int>(1000000.0 * PERIOD_FRAMES / SAMPLE_RATE);
+
+    if (player.set_hardware_params(params) < 0)
+    {
+      results.push_back(skipped(name));
+      return;
+    }
+
+    BenchResult result = run_case(name, player.get_period_size(), seconds, [&]()
+    {
+      return body(player);
+    });
+
+    results.push_back(result);
+  }
+  catch (const std::system_error&)
+  {
+    results.push_back(skipped(name));
+  }
+}
+
+void bench_devices(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+  // Buffers are sized generously so whatever period the device settles on fits.
+  std::vector<int16_t> s16(PERIOD_FRAMES * 2 * 4, 1000);
+  std::vector<float> floats(PERIOD_FRAMES * 2 * 4, 0.25f);
+
+  MockBackend* mock = nullptr;
+  BackendFactory open_mock = [&]()
+  {
+    mock = new MockBackend(SND_PCM_STREAM_PLAYBACK);
+    return std::unique_ptr<PCMBackend>(mock);
+  };
+
+  const std::string devices[] = {options.null_device, options.file_device, ""};
+  const char* labels[] = {"null", "file", "mock"};
+
+  for (int d = 0; d < 3; d++)
+  {
+    std::string prefix = std::string("pcm/") + labels[d] + "/";
+    BackendFactory open_backend = open_mock;
+
+    if (!devices[d].empty())
+    {
+      std::string device = devices[d];
+      open_backend = [device]()
+      {
+        return std::unique_ptr<PCMBackend>(new AlsaBackend(device, SND_PCM_STREAM_PLAYBACK));
+      };
+    }
+
+    bench_device(prefix + "write_interleaved_s16", open_backend, SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, options.seconds, results,
+      [&](PCMPlayer& player)
+    {
+      return player.write_interleaved(s16.data(), player.get_period_size()) >= 0;
+    });
+
+    bench_device(prefix + "mmap_interleaved_s16", open_backend, SND_PCM_ACCESS_MMAP_INTERLEAVED, SND_PCM_FORMAT_S16_LE, options.seconds, results,
+      [&](PCMPlayer& player)
+    {
+      return player.write_interleaved(s16.data(), player.get_period_size()) >= 0;
+    });
+
+    bench_device(prefix + "write_float_s16", open_backend, SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, options.seconds, results,
+      [&](PCMPlayer& player)
+    {
+      return player.write_float(floats.data(), player.get_period_size()) >= 0;
+    });
+
+    bench_device(prefix + "mmap_write_float_s16", open_backend, SND_PCM_ACCESS_MMAP_INTERLEAVED, SND_PCM_FORMAT_S16_LE, options.seconds, results,
+      [&](PCMPlayer& player)
+    {
+      return player.write_float(floats.data(), player.get_period_size()) >= 0;
+    });
+  }
+
+  // Every period underruns and has to be recovered before it is written.
+  bool restart_policy_set = false;
+
+  bench_device("pcm/mock/xrun_recovery_s16", open_mock, SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, options.seconds, results,
+    [&](PCMPlayer& player)
+  {
+    if (!restart_policy_set)
+    {
+      XrunPolicy policy;
+      policy.action = XrunAction::RESTART;
+      player.set_xrun_policy(policy);
+      restart_policy_set = true;
+    }
+
+    mock->inject_xrun();
+    return player.write_interleaved(s16.data(), player.get_period_size()) >= 0;
+  });
+}
+
+void write_json(std::ostream& out, const std::vector<BenchResult>& results)
+{
+  out << "{\n";
+  out << "  \"conversion_backend\": \"" << conversion_backend() << "\",\n";
+  out << "  \"results\": [\n";
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult& result = results[i];
+    bool measured = (result.status == "ok" && result.periods > 0);
+    double frames_per_sec = measured ? (result.periods * result.period_frames) / result.seconds : 0.0;
+    double ns_per_period = measured ? (result.seconds * 1e9) / result.periods : 0.0;
+
+    out << "    {\"name\": \"" << result.name << "\", \"status\": \"" << result.status << "\"";
+    out << ", \"period_frames\": " << result.period_frames;
+    out << ", \"periods\": " << result.periods;
+    out << ", \"frames_per_sec\": " << static_cast<uint64_t>(frames_per_sec);
+    out << ", \"ns_per_period\": " << static_cast<uint64_t>(ns_per_period) << "}";
+    out << ((i + 1 < results.size()) ? ",\n" : "\n");
+  }
+
+  out << "  ]\n";
+  out << "}" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  BenchOptions options;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+
+    if (i + 1 >= argc)
+    {
+      std::cerr << "Usage: pcm_bench [--seconds S] [--null-device PCM] [--file-device PCM] [--output PATH]" << std::endl;
+      return -1;
+    }
+
+    if (arg == "--seconds")
+      options.seconds = std::stod(argv[++i]);
+    else if (arg == "--null-device")
+      options.null_device = argv[++i];
+    else if (arg == "--file-device")
+      options.file_device = argv[++i];
+    else if (arg == "--output")
+      options.output_path = argv[++i];
+    else
+    {
+      std::cerr << "Unknown argument " << arg << "." << std::endl;
+      return -1;
+    }
+  }
+
+  std::vector<BenchResult> results;
+
+  bench_conversion(options, results);
+  bench_mixing(options, results);
+  bench_resampling(options, results);
+  bench_gain(options, results);
+  bench_devices(options, results);
+
+  write_json(std::cout, results);
+
+  if (!options.output_path.empty())
+  {
+    std::ofstream out(options.output_path);
+    write_json(out, results);
+  }
+
+  for (const BenchResult& result : results)
+  {
+    if (result.status == "failed")
+      return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <alsaplusplus/pcm.hpp>
+
+using namespace AlsaPlusPlus;
+
+// Measures round-trip latency through a loopback: a test signal is played on
+// one PCM and captured on another (snd-aloop, or a cable from output to
+// input), and the capture is cross-correlated against the signal to find
+// where it arrived. Two figures are reported for each run:
+//
+//  - round trip: wall-clock time from write_float accepting the signal's
+//    first frame until read_float returns the frame it arrived in. This is
+//    what an application sees, playback and capture buffering included, so
+//    it grows with the period and buffer size. It is resolved to a period.
+//  - hardware path: the same interval in sample clocks, with both streams'
+//    trigger timestamps lining the clocks up. Queueing in the two ring
+//    buffers cancels out, leaving converter, transport and loopback delay.
+//
+// Each period size is measured several times to show jitter.
+//
+// Usage: latency_tool <playback PCM> <capture PCM> [--signal impulse|mls]
+//          [--rate HZ] [--runs N] [--periods-us LIST] [--json PATH]
+
+static const double LEAD_IN_SECONDS = 0.1; // silence before the signal
+static const double LISTEN_SECONDS = 0.5; // longest latency we look for
+static const unsigned int MLS_ORDER = 12;
+
+struct ToolOptions
+{
+  std::string playback_device;
+  std::string capture_device;
+  bool use_mls = true;
+  unsigned int rate = 48000;
+  unsigned int runs = 10;
+  std::vector<unsigned int> period_times_us = {1000, 2666, 5333, 10666, 21333};
+  std::string json_path;
+};
+
+struct ConfigResult
+{
+  unsigned int period_time_us;
+  snd_pcm_uframes_t period_frames;
+  snd_pcm_uframes_t buffer_frames;
+  std::vector<double> latencies_ms; // application round trip
+  std::vector<double> hardware_latencies_ms;
+  unsigned int failed_runs;
+};
+
+struct Measurement
+{
+  double round_trip_ms;
+  double hardware_ms;
+};
+
+// Maximum-length sequence from a 12-bit Fibonacci LFSR (taps 12, 6, 4, 1):
+// flat spectrum and a single sharp autocorrelation peak, so it survives
+// noise far better than a lone impulse.
+std::vector<float> make_mls(float amplitude)
+{
+  std::vector<float> sequence((1u << MLS_ORDER) - 1);
+  uint32_t state = 1;
+
+  for (size_t i = 0; i < sequence.size(); i++)
+  {
+    uint32_t bit = ((state >> 11) ^ (state >> 5) ^ (state >> 3) ^ state) & 1;
+    state = ((state << 1) | bit) & 0xFFF;
+    sequence[i] = bit ? amplitude : -amplitude;
+  }
+
+  return sequence;
+}
+
+// Returns the lag with the largest correlation, and the ratio of that peak
+// to the largest value more than one signal length away, as a confidence
+// measure.
+size_t find_signal(const std::vector<float>& captured, const std::vector<float>& signal, double& peak_ratio)
+{
+  size_t lags = (captured.size() > signal.size()) ? captured.size() - signal.size() : 0;
+  std::vector<double> correlation(lags, 0.0);
+  size_t best = 0;
+
+  for (size_t lag = 0; lag < lags; lag++)
+  {
+    double sum = 0.0;
+
+    for (size_t i = 0; i < signal.size(); i++)
+      sum += captured[lag + i] * signal[i];
+
+    correlation[lag] = std::fabs(sum);
+
+    if (correlation[lag] > correlation[best])
+      best = lag;
+  }
+
+  double runner_up = 0.0;
+
+  for (size_t lag = 0; lag < lags; lag++)
+  {
+    size_t distance = (lag > best) ? lag - best : best - lag;
+
+    if (distance > signal.size() && correlation[lag] > runner_up)
+      runner_up = correlation[lag];
+  }
+
+  peak_ratio = (runner_up > 0.0) ? correlation[best] / runner_up : INFINITY;
+
+  return best;
+}
+
+double timestamp_seconds(const snd_htimestamp_t& stamp)
+{
+  return stamp.tv_sec + stamp.tv_nsec * 1e-9;
+}
+
+HwParams make_params(const ToolOptions& options, unsigned int period_time_us)
+{
+  HwParams params;
+
+  params.access_type = SND_PCM_ACCESS_RW_INTERLEAVED;
+  params.format_type = SND_PCM_FORMAT_S16_LE;
+  params.sample_rate_hz = options.rate;
+  params.channels = AudioChannels::MONO;
+  params.period_time_us = period_time_us;
+  params.resampler_quality = ResamplerQuality::DISABLED; // A resampler would add its own delay.
+  params.channel_mixing = false;
+
+  return params;
+}
+
+// One measurement. Returns false if the signal wasn't found.
+bool measure_once(const ToolOptions& options, unsigned int period_time_us, const std::vector<float>& signal, ConfigResult& config, Measurement& measurement)
+{
+  PCMPlayer player(options.playback_device);
+  PCMRecorder recorder(options.capture_device);
+
+  if (player.set_hardware_params(make_params(options, period_time_us)) < 0 ||
+      recorder.set_hardware_params(make_params(options, period_time_us)) < 0)
+    return false;
+
+  config.period_frames = player.get_period_size();
+  config.buffer_frames = player.get_buffer_size();
+
+  unsigned int rate = player.get_hardware_params().sample_rate_hz;
+  size_t lead_in = static_cast<size_t>(LEAD_IN_SECONDS * rate);
+  size_t capture_frames = lead_in + signal.size() + static_cast<size_t>(LISTEN_SECONDS * rate);
+  snd_pcm_uframes_t period = config.period_frames;
+
+  std::vector<float> playback(capture_frames + config.buffer_frames, 0.0f);
+  std::copy(signal.begin(), signal.end(), playback.begin() + lead_in);
+
+  std::vector<float> captured(capture_frames + period, 0.0f);
+  std::atomic<bool> capturing(true);
+
+  // When the period holding the signal's first frame was queued (a blocking
+  // write returns once it is in the buffer), and how many frames had been
+  // captured when each read returned.
+  std::chrono::steady_clock::time_point signal_sent;
+  std::vector<std::pair<size_t, std::chrono::steady_clock::time_point>> reads;
+  reads.reserve(capture_frames / period + 2);
+
+  std::thread playback_thread([&]()
+  {
+    for (size_t frame = 0; capturing && frame + period <= playback.size(); frame += period)
+    {
+      if (player.write_float(playback.data() + frame, period) < 0)
+        break;
+
+      if (frame <= lead_in && lead_in < frame + period)
+        signal_sent = std::chrono::steady_clock::now();
+    }
+  });
+
+  size_t frames_captured = 0;
+
+  while (frames_captured < capture_frames)
+  {
+    snd_pcm_sframes_t got = recorder.read_float(captured.data() + frames_captured, period);
+
+    if (got < 0)
+      break;
+
+    frames_captured += got;
+    reads.emplace_back(frames_captured, std::chrono::steady_clock::now());
+  }
+
+  PCMStatus playback_status;
+  PCMStatus capture_status;
+  bool have_status = (player.get_status(playback_status) == 0 && recorder.get_status(capture_status) == 0);
+
+  capturing = false;
+  playback_thread.join();
+
+  if (!have_status || frames_captured < capture_frames)
+    return false;
+
+  captured.resize(frames_captured);
+
+  double peak_ratio = 0.0;
+  size_t arrival = find_signal(captured, signal, peak_ratio);
+
+  if (peak_ratio < 2.0)
+    return false; // No clear peak: loopback not connected, or too noisy.
+
+  for (const auto& read : reads)
+  {
+    if (read.first > arrival)
+    {
+      measurement.round_trip_ms = std::chrono::duration<double, std::milli>(read.second - signal_sent).count();
+      break;
+    }
+  }
+
+  // Capture frame k was sampled at capture_trigger + k / rate; playback frame
+  // j was played at playback_trigger + j / rate plus the hardware delay.
+  double trigger_offset = timestamp_seconds(playback_status.trigger_timestamp) - timestamp_seconds(capture_status.trigger_timestamp);
+  double latency = (static_cast<double>(arrival) - static_cast<double>(lead_in)) / rate - trigger_offset;
+  measurement.hardware_ms = latency * 1000.0;
+
+  return true;
+}
+
+double percentile(std::vector<double> values, double fraction)
+{
+  std::sort(values.begin(), values.end());
+  size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+
+  return values[index];
+}
+
+void print_summary(const char* label, const std::vector<double>& latencies_ms)
+{
+  double mean = 0.0;
+
+  for (double latency : latencies_ms)
+    mean += latency;
+
+  mean /= latencies_ms.size();
+
+  double variance = 0.0;
+
+  for (double latency : latencies_ms)
+    variance += (latency - mean) * (latency - mean);
+
+  double jitter = std::sqrt(variance / latencies_ms.size());
+
+  std::cout << "  " << label << ": min " << percentile(latencies_ms, 0.0) << " ms, median " << percentile(latencies_ms, 0.5);
+  std::cout << " ms, p95 " << percentile(latencies_ms, 0.95) << " ms, max " << percentile(latencies_ms, 1.0);
+  std::cout << " ms, mean " << mean << " ms, jitter (stddev) " << jitter << " ms" << std::endl;
+}
+
+void print_result(const ConfigResult& result)
+{
+  std::cout << "period " << result.period_time_us << " us (" << result.period_frames << " frames, buffer " << result.buffer_frames << "):";
+
+  if (result.latencies_ms.empty())
+  {
+    std::cout << " no successful runs" << std::endl;
+    return;
+  }
+
+  if (result.failed_runs > 0)
+    std::cout << " " << result.failed_runs << " failed runs";
+
+  std::cout << std::endl;
+
+  print_summary("round trip", result.latencies_ms);
+  print_summary("hardware path", result.hardware_latencies_ms);
+}
+
+void write_json(const std::string& path, const std::vector<ConfigResult>& results)
+{
+  std::ofstream out(path);
+
+  out << "{\n  \"configs\": [\n";
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const ConfigResult& result = results[i];
+
+    out << "    {\"period_time_us\": " << result.period_time_us << ", \"period_frames\": " << result.period_frames;
+    out << ", \"buffer_frames\": " << result.buffer_frames << ", \"failed_runs\": " << result.failed_runs << ", \"latencies_ms\": [";
+
+    for (size_t j = 0; j < result.latencies_ms.size(); j++)
+      out << (j > 0 ? ", " : "") << result.latencies_ms[j];
+
+    out << "], \"hardware_latencies_ms\": [";
+
+    for (size_t j = 0; j < result.hardware_latencies_ms.size(); j++)
+      out << (j > 0 ? ", " : "") << result.hardware_latencies_ms[j];
+
+    out << "]}" << ((i + 1 < results.size()) ? ",\n" : "\n");
+  }
+
+  out << "  ]\n}" << std::endl;
+}
+
+std::vector<unsigned int> parse_list(const std::string& text)
+{
+  std::vector<unsigned int> values;
+  std::istringstream iss(text);
+  std::string item;
+
+  while (std::getline(iss, item, ','))
+    values.push_back(std::stoul(item));
+
+  return values;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: latency_tool <playback PCM> <capture PCM> [--signal impulse|mls] [--rate HZ] [--runs N] [--periods-us LIST] [--json PATH]" << std::endl;
+    return -1;
+  }
+
+  ToolOptions options;
+  options.playback_device = argv[1];
+  options.capture_device = argv[2];
+
+  for (int i = 3; i + 1 < argc; i += 2)
+  {
+    std::string arg = argv[i];
+    std::string value = argv[i + 1];
+
+    if (arg == "--signal")
+      options.use_mls = (value != "impulse");
+    else if (arg == "--rate")
+      options.rate = std::stoul(value);
+    else if (arg == "--runs")
+      options.runs = std::stoul(value);
+    else if (arg == "--periods-us")
+      options.period_times_us = parse_list(value);
+    else if (arg == "--json")
+      options.json_path = value;
+    else
+    {
+      std::cerr << "Unknown argument " << arg << "." << std::endl;
+      return -1;
+    }
+  }
+
+  std::vector<float> signal = options.use_mls ? make_mls(0.5f) : std::vector<float>(1, 0.9f);
+  std::vector<ConfigResult> results;
+
+  for (unsigned int period_time_us : options.period_times_us)
+  {
+    ConfigResult result = {period_time_us, 0, 0, {}, {}, 0};
+
+    for (unsigned int run = 0; run < options.runs; run++)
+    {
+      Measurement measurement;
+      bool found = false;
+
+      try
+      {
+        found = measure_once(options, period_time_us, signal, result, measurement);
+      }
+      catch (const std::system_error& e)
+      {
+        std::cerr << "Cannot open devices: " << e.what() << std::endl;
+        return -2;
+      }
+
+      if (!found)
+      {
+        result.failed_runs++;
+        continue;
+      }
+
+      result.latencies_ms.push_back(measurement.round_trip_ms);
+      result.hardware_latencies_ms.push_back(measurement.hardware_ms);
+    }
+
+    print_result(result);
+    results.push_back(result);
+  }
+
+  if (!options.json_path.empty())
+    write_json(options.json_path, results);
+
+  return 0;
+}
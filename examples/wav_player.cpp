@@ -1,211 +1,206 @@
 #include <cstdio>
 #include <cstdint>
-#include <fstream>
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include <alsaplusplus/pcm.hpp>
+#include <alsaplusplus/wav_file.hpp>
+#include <alsaplusplus/wav_stream.hpp>
+
+#include <chrono>
+#include <thread>
 
 using namespace AlsaPlusPlus;
 
-static const uint16_t BUFFER_SIZE = 4096;
+// Period length requested from the device.
+static const unsigned int PERIOD_TIME_US = 20000;
+
+// Periods of read-ahead buffered by --stream.
+static const unsigned int STREAM_PERIODS = 16;
 
-struct WavHeader
+// Hands the mapped data chunk to the player one period at a time, straight
+// from the page cache. Pages already played are released so memory use
+// stays flat no matter how long the file is. A data chunk that isn't aligned
+// for SAMPLE_TYPE is copied through one period of scratch instead.
+template <typename SAMPLE_TYPE>
+int play_frames(PCMPlayer& player, WavFile& wav)
 {
-  /* RIFF Chunk Descriptor */
-	uint8_t         RIFF[4];          // RIFF Header Magic header
-	uint32_t        chunk_size;       // RIFF Chunk Size
-	uint8_t         WAVE[4];          // WAVE Header
-	/* "fmt" sub-chunk */
-	uint8_t         fmt[4];           // FMT header
-	uint32_t        subchunk1size;    // Size of the fmt chunk
-	uint16_t        audio_format;     // Audio format 1=PCM,6=mulaw,7=alaw,
-                                    // 257=IBM Mu-Law, 258=IBM A-Law, 259=ADPCM
-	uint16_t        num_of_chan;      // Number of channels 1=Mono 2=Sterio
-	uint32_t        samples_per_sec;  // Sampling Frequency in Hz
-	uint32_t        bytes_per_sec;    // bytes per second
-	uint16_t        block_align;      // 2=16-bit mono, 4=16-bit stereo
-	uint16_t        bits_per_sample;  // Number of bits per sample
-	/* "data" sub-chunk */
-	uint8_t         subchunk2id[4];   // "data"  string
-	uint32_t        subchunk2size;    // Sampled data length
-};
-
-int getFileSize(std::ifstream& in_file)
+  snd_pcm_uframes_t period_frames = player.get_period_size();
+  uint64_t total_frames = wav.frames();
+  uint64_t frame = 0;
+  size_t frame_bytes = wav.format().block_align;
+  std::vector<SAMPLE_TYPE> scratch;
+
+  if (wav.frame_view<SAMPLE_TYPE>() == nullptr)
+    scratch.resize(period_frames * frame_bytes / sizeof(SAMPLE_TYPE));
+
+  while (frame < total_frames)
+  {
+    uint64_t remaining = total_frames - frame;
+    snd_pcm_uframes_t chunk = (remaining < period_frames) ? remaining : period_frames;
+    const SAMPLE_TYPE* frames = wav.frame_view<SAMPLE_TYPE>(frame);
+
+    if (frames == nullptr)
+    {
+      memcpy(scratch.data(), wav.frame_data(frame), chunk * frame_bytes);
+      frames = scratch.data();
+    }
+
+    snd_pcm_sframes_t written = player.write_interleaved(frames, chunk);
+
+    if (written < 0)
+      return written;
+
+    frame += chunk;
+    wav.release(frame);
+  }
+
+  return 0;
+}
+
+// Reads on a worker thread into a ring the player drains, for storage
+// where mapping the file could stall playback on page faults.
+int stream_frames(PCMPlayer& player, WavStreamSource& source)
 {
-  int file_size = 0;
+  FrameRingBuffer ring(source.format().block_align, player.get_period_size(), STREAM_PERIODS);
+
+  if (source.start(ring) < 0)
+    return -1;
+
+  while (!source.finished() || ring.read_available() > 0)
+  {
+    if (ring.read_available() == 0)
+    {
+      // The disk fell behind the buffered audio.
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
 
-  in_file.seekg(0, in_file.end);
-  file_size = in_file.tellg();
-  in_file.seekg(0, in_file.beg);
+    snd_pcm_sframes_t played = player.play_from_ring(ring, player.get_period_size());
 
-  return file_size;
+    if (played < 0)
+    {
+      source.stop();
+      return played;
+    }
+  }
+
+  return source.get_error();
 }
 
 int main(int argc, char** argv)
 {
-  if (argc < 2)
+  bool streaming = (argc > 1 && std::string(argv[1]) == "--stream");
+  int first_arg = streaming ? 2 : 1;
+
+  if (argc < first_arg + 1)
   {
-    std::cerr << "Not enough arguments provided." << std::endl;
+    std::cerr << "Usage: wav_player [--stream] <file> [device]" << std::endl;
     return -1;
   }
-  else if (argc > 3)
+  else if (argc > first_arg + 2)
   {
     std::cerr << "Too many arguments provided." << std::endl;
     return -1;
   }
 
-  WavHeader wav_hdr;
-  int header_size = sizeof(wav_hdr);
-  int file_length = 0;
-  const char* file_path;
-
-  file_path = argv[1];
+  const char* file_path = argv[first_arg];
+  std::string device_name = (argc == first_arg + 2) ? argv[first_arg + 1] : "default";
 
-  std::ifstream wav_file(file_path, std::ios::in | std::ifstream::binary);
+  WavFile wav;
+  WavStreamSource source;
+  int open_err = streaming ? source.open(file_path) : wav.open(file_path);
 
-  if (!wav_file.good())
+  if (open_err < 0)
   {
     std::cerr << "Unable to open WAV file " << file_path << "." << std::endl;
     return -2;
   }
 
-  wav_file.read((char*)&wav_hdr, header_size);
+  const WavFormat& format = streaming ? source.format() : wav.format();
+  uint64_t total_frames = streaming ? source.frames() : wav.frames();
+
+  std::cout << "\nWe read a WAV file header! Here's what it said:" << std::endl;
+  std::cout << "\n";
+  std::cout << "\tAudio Format:     " << (format.format_tag == 3 ? "IEEE float" : "PCM") << std::endl;
+  std::cout << "\tSampling rate:    " << format.sample_rate_hz << std::endl;
+  std::cout << "\tBits per sample:  " << format.bits_per_sample << " (" << format.valid_bits << " valid)" << std::endl;
+  std::cout << "\tChannels:         " << format.channels << std::endl;
+  std::cout << "\tBlock align:      " << format.block_align << std::endl;
+  std::cout << "\tFrames:           " << total_frames << std::endl;
+  std::cout << "\tDuration:         " << static_cast<double>(total_frames) / format.sample_rate_hz << " s" << std::endl;
+  std::cout << "\n" << std::endl;
+
+  if (format.pcm_format == SND_PCM_FORMAT_UNKNOWN)
+  {
+    std::cerr << "The sample format of the file has no ALSA equivalent." << std::endl;
+    return -3;
+  }
 
-  if (wav_file.good())
+  if (format.channels > static_cast<int>(AudioChannels::FULL_SURROUND_PLUS_SUB))
   {
-    uint16_t bytes_per_sample = wav_hdr.bits_per_sample / 8;            // Number of bytes per sample
-    uint64_t num_samples = wav_hdr.chunk_size / bytes_per_sample;       // Number of samples in file
-    file_length = getFileSize(wav_file);                                // Size of the file
+    std::cerr << "Files with more than 6 channels are not supported." << std::endl;
+    return -4;
+  }
 
-    if (wav_hdr.audio_format != 1)
-    {
-      std::cerr << "This application only accepts PCM-formatted WAV files." << std::endl;
-      wav_file.close();
-      return -3;
-    }
+  std::cout << "Setting up the PCM player on " << device_name << "...\n" << std::endl;
 
-    std::cout << "\nWe read a WAV file header! It had " << header_size << " bytes. Here's what it said:" << std::endl;
-    std::cout << "\n";
-    std::cout << "\tFile is:          " << file_length << " bytes." << std::endl;
-    std::cout << "\tRIFF header:      " << wav_hdr.RIFF[0] << wav_hdr.RIFF[1] << wav_hdr.RIFF[2] << wav_hdr.RIFF[3] << std::endl;
-    std::cout << "\tWAVE header:      " << wav_hdr.WAVE[0] << wav_hdr.WAVE[1] << wav_hdr.WAVE[2] << wav_hdr.WAVE[3] << std::endl;
-    std::cout << "\tFMT:              " << wav_hdr.fmt[0] << wav_hdr.fmt[1] << wav_hdr.fmt[2] << wav_hdr.fmt[3] << std::endl;
-    std::cout << "\tData size:        " << wav_hdr.chunk_size << std::endl;
-    std::cout << "\n";
-    std::cout << "\tSampling rate:    " << wav_hdr.samples_per_sec << std::endl;
-    std::cout << "\tBits per sample:  " << wav_hdr.bits_per_sample << std::endl;
-    std::cout << "\tChannels:         " << wav_hdr.num_of_chan << std::endl;
-    std::cout << "\tBytes per second: " << wav_hdr.bytes_per_sec << std::endl;
-    std::cout << "\tData length:      " << wav_hdr.subchunk2size << std::endl;
-    std::cout << "\tAudio Format:     " << wav_hdr.audio_format << std::endl;
-    std::cout << "\n";
-    std::cout << "\tBlock align:      " << wav_hdr.block_align << std::endl;
-    std::cout << "\tData string:      " << wav_hdr.subchunk2id[0] << wav_hdr.subchunk2id[1] << wav_hdr.subchunk2id[2];
-    std::cout << wav_hdr.subchunk2id[3];
-    std::cout << "\n" << std::endl;
-
-    std::cout << "Setting up the PCM player...\n" << std::endl;
-
-    PCMPlayer player("default");
-    HwParams params;
-
-    params.access_type = SND_PCM_ACCESS_RW_INTERLEAVED; // PCM audio is always interleaved.
-
-    // WAV data is always stored in Little-Endian byte order so we choose
-    // the format based on the bits per sample. <=8 bits/sample is unsigned,
-    // >8 bits/sample is signed. See
-    // http://www-mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/Docs/riffmci.pdf
-    switch (wav_hdr.bits_per_sample)
-    {
-      case 8:
-        params.format_type = SND_PCM_FORMAT_U8;
-        std::cout << "Format type is SND_PCM_FORMAT_U8." << std::endl;
-        break;
-      case 16:
-        params.format_type = SND_PCM_FORMAT_S16_LE;
-        std::cout << "Format type is SND_PCM_FORMAT_S16_LE." << std::endl;
-        break;
-      case 24:
-        params.format_type = SND_PCM_FORMAT_S24_LE;
-        std::cout << "Format type is SND_PCM_FORMAT_S24_LE." << std::endl;
-        break;
-      case 32:
-        params.format_type = SND_PCM_FORMAT_S32_LE;
-        std::cout << "Format type is SND_PCM_FORMAT_S32_LE." << std::endl;
-        break;
-      default:
-        std::cerr << "The number of bits per sample in the file is non-standard." << std::endl;
-        return -4;
-        break;
-    }
+  PCMPlayer player(device_name);
+  HwParams params;
+
+  params.access_type = SND_PCM_ACCESS_RW_INTERLEAVED; // WAV audio is always interleaved.
+  params.format_type = format.pcm_format;
+  params.sample_rate_hz = format.sample_rate_hz;
+  params.channels = static_cast<AudioChannels>(format.channels);
+  params.period_time_us = PERIOD_TIME_US;
+  params.channel_mixing = false; // Frames go to the device untouched.
 
-    params.sample_rate_hz = wav_hdr.samples_per_sec;
-    params.channels = static_cast<AudioChannels>(wav_hdr.num_of_chan);
+  std::cout << "Format type is " << snd_pcm_format_name(format.pcm_format) << "." << std::endl;
 
-    // To calculate the period time in microseconds, we take the source
-    // bytes per second divided by the size of the buffer (in bytes) to get the number
-    // of buffer fills (periods) required per second. We then divide 1,000,000
-    // (number of microseconds in a second) by the periods per second to get the
-    // number of microseconds for each period (approximate).
-    float periods_per_sec = (wav_hdr.bytes_per_sec / (BUFFER_SIZE / (wav_hdr.bits_per_sample / 8)));
-    params.period_time_us = 1000000.0 / periods_per_sec; // Microseconds per period (requested)
+  if (player.set_hardware_params(params) < 0)
+  {
+    std::cerr << "Unable to configure the PCM device." << std::endl;
+    return -5;
+  }
 
-    player.set_hardware_params(params);
+  if (player.get_hardware_params().sample_rate_hz != format.sample_rate_hz)
+    std::cout << "The device runs at a different rate; use the plug layer (e.g. \"default\") for correct pitch." << std::endl;
 
-    std::cout << "Now we'll play the file.\n" << std::endl;
+  std::cout << "Now we'll play the file.\n" << std::endl;
 
-    std::vector<uint8_t> u8_buffer;
-    std::vector<int16_t> s16_buffer;
-    std::vector<int32_t> s32_buffer;
+  int play_err = 0;
 
-    switch (wav_hdr.bits_per_sample)
-    {
-      case 8:
-      {
-        u8_buffer.reserve(BUFFER_SIZE / sizeof u8_buffer[0]);
-
-        /*
-        while ((bytes_read = fread(&(u8_buffer[0]), sizeof u8_buffer[0], BUFFER_SIZE / (sizeof u8_buffer[0]), wav_file)) > 0)
-        {
-          std::cout << "Bytes read: " << bytes_read << std::endl;
-          player.play_interleaved<uint8_t>(u8_buffer);
-        }
-        */
-      } break;
-      case 16:
-      {
-        s16_buffer.reserve(BUFFER_SIZE / sizeof s16_buffer[0]);
-
-        /*
-        while ((bytes_read = fread(&(s16_buffer[0]), sizeof s16_buffer[0], BUFFER_SIZE / (sizeof s16_buffer[0]), wav_file)) > 0)
-        {
-          std::cout << "Bytes read: " << bytes_read << std::endl;
-          player.play_interleaved<int16_t>(s16_buffer);
-        }
-        */
-      } break;
-      case 24:
-      case 32:
-      {
-        s32_buffer.reserve(BUFFER_SIZE / sizeof s32_buffer[0]);
-
-        /*
-        while ((bytes_read = fread(&(s32_buffer[0]), sizeof s32_buffer[0], BUFFER_SIZE / (sizeof s32_buffer[0]), wav_file)) > 0)
-        {
-          std::cout << "Bytes read: " << bytes_read << std::endl;
-          player.play_interleaved<int32_t>(s32_buffer);
-        }
-        */
-      } break;
-    }
+  if (streaming)
+  {
+    play_err = stream_frames(player, source);
   }
   else
   {
-    std::cout << "Failed to read header from file." << std::endl;
+    switch (format.pcm_format)
+    {
+      case SND_PCM_FORMAT_U8:
+        play_err = play_frames<uint8_t>(player, wav);
+        break;
+      case SND_PCM_FORMAT_S16_LE:
+        play_err = play_frames<int16_t>(player, wav);
+        break;
+      case SND_PCM_FORMAT_S24_3LE:
+        play_err = play_frames<S24PackedSample>(player, wav);
+        break;
+      case SND_PCM_FORMAT_S32_LE:
+        play_err = play_frames<int32_t>(player, wav);
+        break;
+      case SND_PCM_FORMAT_FLOAT_LE:
+        play_err = play_frames<float>(player, wav);
+        break;
+      default:
+        break;
+    }
   }
 
-  wav_file.close();
+  if (play_err < 0)
+    std::cerr << "Playback stopped early." << std::endl;
 
   std::cout << "Done!\n" << std::endl;
 
@@ -0,0 +1,46 @@
+#ifndef ALSAPLUSPLUS_CHANNEL_MATRIX_HPP
+#define ALSAPLUSPLUS_CHANNEL_MATRIX_HPP
+
+#include <alsaplusplus/common.hpp>
+
+namespace AlsaPlusPlus
+{
+  //Up/down-mix from one channel layout to another, applied to interleaved
+  //float frames. Channels follow ALSA's default order for each
+  //AudioChannels layout: FL FR, then LFE for 2.1, otherwise RL RR, FC, LFE.
+  class ChannelMatrix
+  {
+    public:
+      static const unsigned int MAX_CHANNELS = 8;
+
+      ChannelMatrix();
+      ChannelMatrix(unsigned int input_channels, unsigned int output_channels); //all gains 0
+
+      //Built-in mix between two layouts: shared speakers pass through,
+      //missing centre/rear speakers fold into the fronts at -3 dB, LFE is
+      //dropped on downmix, and mono is copied to both fronts. Rows are
+      //scaled so no output can exceed full scale. Counts outside the enum
+      //map channel n to channel n.
+      static ChannelMatrix preset(AudioChannels input, AudioChannels output);
+
+      void set_gain(unsigned int output_channel, unsigned int input_channel, float gain);
+      float get_gain(unsigned int output_channel, unsigned int input_channel) const;
+      unsigned int input_channels() const;
+      unsigned int output_channels() const;
+      bool is_identity() const;
+
+      //Mixes frame_count frames from input into output. The buffers must
+      //not overlap.
+      void apply(const float* input, float* output, size_t frame_count) const;
+
+    private:
+      void update_columns();
+
+      unsigned int inputs;
+      unsigned int outputs;
+      std::vector<float> gains; //outputs rows of inputs each
+      std::vector<float> columns; //per input, its gains padded to MAX_CHANNELS outputs
+  };
+}
+
+#endif
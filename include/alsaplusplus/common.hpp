@@ -5,6 +5,7 @@
 extern "C"
 {
 #include <unistd.h>
+#include <poll.h>
 #include <cstdio>
 #include <cstring>
 }
@@ -0,0 +1,65 @@
+#ifndef ALSAPLUSPLUS_CONVERT_HPP
+#define ALSAPLUSPLUS_CONVERT_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsaplusplus/format_traits.hpp>
+#include <alsa/pcm.h>
+
+#include <cstdint>
+
+namespace AlsaPlusPlus
+{
+  //Per-stream state for TPDF dither: one xorshift32 generator per SIMD lane.
+  struct DitherState
+  {
+    uint32_t lanes[8];
+
+    DitherState(uint32_t seed = 0x9E3779B9u);
+  };
+
+  //Which kernel set convert_* dispatched to on this CPU ("avx2", "sse2",
+  //"neon" or "scalar").
+  const char* conversion_backend();
+
+  //Converts float samples in [-1.0, 1.0) to format, clipping anything out of
+  //range. With dither non-null, integer formats of 24 bits or fewer get
+  //+-1 LSB triangular dither before rounding. Supports U8, S16_LE, S24_LE,
+  //S24_3LE, S32_LE and FLOAT_LE. Returns 0 or a negative error code.
+  int convert_from_float(const float* src, void* dst, snd_pcm_format_t format, size_t samples, DitherState* dither = nullptr);
+
+  //Converts samples in format to float in [-1.0, 1.0).
+  int convert_to_float(const void* src, float* dst, snd_pcm_format_t format, size_t samples);
+
+  bool conversion_supported(snd_pcm_format_t format);
+
+  //Typed overloads: the destination/source type picks the kernel at compile
+  //time, skipping the format switch. Same scaling and dither rules as above.
+  void convert_from_float(const float* src, uint8_t* dst, size_t samples, DitherState* dither = nullptr);
+  void convert_from_float(const float* src, int16_t* dst, size_t samples, DitherState* dither = nullptr);
+  void convert_from_float(const float* src, S24Sample* dst, size_t samples, DitherState* dither = nullptr);
+  void convert_from_float(const float* src, S24PackedSample* dst, size_t samples, DitherState* dither = nullptr);
+  void convert_from_float(const float* src, int32_t* dst, size_t samples, DitherState* dither = nullptr);
+  void convert_from_float(const float* src, float* dst, size_t samples, DitherState* dither = nullptr);
+
+  void convert_to_float(const uint8_t* src, float* dst, size_t samples);
+  void convert_to_float(const int16_t* src, float* dst, size_t samples);
+  void convert_to_float(const S24Sample* src, float* dst, size_t samples);
+  void convert_to_float(const S24PackedSample* src, float* dst, size_t samples);
+  void convert_to_float(const int32_t* src, float* dst, size_t samples);
+  void convert_to_float(const float* src, float* dst, size_t samples);
+
+  //Format-parameterized forms for callers that hold the format as a constant.
+  template <snd_pcm_format_t FORMAT>
+    void convert_from_float(const float* src, typename FormatTraits<FORMAT>::sample_type* dst, size_t samples, DitherState* dither = nullptr)
+  {
+    convert_from_float(src, dst, samples, dither);
+  }
+
+  template <snd_pcm_format_t FORMAT>
+    void convert_to_float(const typename FormatTraits<FORMAT>::sample_type* src, float* dst, size_t samples)
+  {
+    convert_to_float(src, dst, samples);
+  }
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef ALSAPLUSPLUS_DEVICE_CATALOG_HPP
+#define ALSAPLUSPLUS_DEVICE_CATALOG_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsa/control.h>
+#include <alsa/pcm.h>
+#include <alsa/mixer.h>
+
+#include <map>
+
+namespace AlsaPlusPlus
+{
+  //What one direction of a PCM endpoint accepts, as reported by an
+  //unrestricted snd_pcm_hw_params_any. Sizes are in frames.
+  struct PCMCapabilities
+  {
+    bool probed = false; //false if the endpoint couldn't be opened, e.g. while busy
+    std::vector<snd_pcm_access_t> access_types;
+    std::vector<snd_pcm_format_t> formats;
+    std::vector<unsigned int> rates; //the common rates within [rate_min, rate_max] that test as accepted
+    unsigned int rate_min = 0;
+    unsigned int rate_max = 0;
+    unsigned int channels_min = 0;
+    unsigned int channels_max = 0;
+    snd_pcm_uframes_t period_size_min = 0;
+    snd_pcm_uframes_t period_size_max = 0;
+    unsigned int periods_min = 0;
+    unsigned int periods_max = 0;
+    snd_pcm_uframes_t buffer_size_min = 0;
+    snd_pcm_uframes_t buffer_size_max = 0;
+  };
+
+  struct PCMEndpoint
+  {
+    std::string name; //as passed to snd_pcm_open
+    std::string description;
+    std::string card_id; //empty for endpoints not tied to one card
+    bool playback = false;
+    bool capture = false;
+    //Only hw: endpoints are probed - plugins accept nearly anything and
+    //opening some of them (dmix, network sinks) is slow.
+    PCMCapabilities playback_caps;
+    PCMCapabilities capture_caps;
+  };
+
+  struct CardProfile
+  {
+    std::string id; //e.g. "PCH", stable across reboots unlike the card index
+    std::string fingerprint; //driver and long name - a different card reusing the ID won't match
+    bool complete = false; //every endpoint and the mixer were probed
+    std::vector<std::string> mixer_elements; //simple element names, index 0
+    std::map<std::string, PCMEndpoint> endpoints; //hw: endpoints by name
+  };
+
+  //PCM endpoints from snd_device_name_hint, with the capabilities of every
+  //card's hardware endpoints and the names of its mixer elements.
+  //
+  //Probing means opening each endpoint and its card's mixer, which takes
+  //milliseconds per endpoint and far longer for a busy or slow USB device,
+  //so probes run in parallel and their results can be kept in a cache file
+  //keyed by card ID. A scan with a warm cache opens no devices at all; a
+  //card is only probed again when it is new or its fingerprint changed.
+  class DeviceCatalog
+  {
+    public:
+      DeviceCatalog();
+
+      //Rebuilds the catalog. With a cache_path the cache is read first and
+      //rewritten afterwards if anything had to be probed. Returns the number
+      //of endpoints found, or a negative error code.
+      int scan(std::string cache_path = std::string());
+      //0 uses one thread per hardware thread.
+      void set_probe_threads(unsigned int threads);
+
+      const std::vector<PCMEndpoint>& get_endpoints();
+      const PCMEndpoint* find_endpoint(std::string name);
+      const CardProfile* find_card(std::string card_id);
+      //Cached answers to Mixer::device_exists and Mixer::element_exists for
+      //the cards found by the last scan.
+      bool card_exists(std::string card_id);
+      bool mixer_element_exists(std::string card_id, std::string element_name);
+
+      int load_cache(std::string cache_path);
+      int save_cache(std::string cache_path);
+
+    private:
+      int enumerate_cards(std::map<std::string, CardProfile>& found);
+      int enumerate_endpoints();
+      void probe_cards(std::vector<CardProfile*>& stale);
+
+      unsigned int probe_threads;
+      std::vector<PCMEndpoint> endpoints;
+      std::map<std::string, CardProfile> cards;
+      std::map<std::string, CardProfile> cached_cards;
+  };
+}
+
+#endif
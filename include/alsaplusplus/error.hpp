@@ -1,6 +1,8 @@
 #ifndef ALSAPLUSPLUS_ERROR_HPP
 #define ALSAPLUSPLUS_ERROR_HPP
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <system_error>
 
@@ -11,7 +13,42 @@ extern "C"
 
 namespace AlsaPlusPlus
 {
-  void handle_error_code(int err_code, bool throws, std::string error_desc);
+  //Category for ALSA error codes: errno values plus alsa-lib's own codes
+  //from SND_ERROR_BEGIN up. Values are stored positive whatever sign the
+  //library returned; messages come from snd_strerror and errno values
+  //compare equal to the matching std::errc.
+  const std::error_category& alsa_category();
+  std::error_code make_alsa_error_code(int err_code);
+
+  struct ErrorEvent
+  {
+    int code; //as passed to handle_error_code
+    const char* description;
+    char context[64]; //copied from the caller, possibly truncated; empty if none
+    uint64_t timestamp_ns; //steady clock
+  };
+
+  typedef std::function<void(const ErrorEvent& event)> ErrorSink;
+
+  //Reported errors are queued and handed to the sink from a library-owned
+  //drain thread, never on the reporting thread. The thread is started here,
+  //by set_error_sink and when a PCMDevice, Mixer or DeviceCatalog is
+  //constructed - never from an audio thread or while the library loads -
+  //and sleeps until an error is queued. Until then errors wait in the queue
+  //and are flushed at exit.
+  void start_error_drain();
+  //The default sink prints to std::cerr; pass nullptr to restore it.
+  void set_error_sink(ErrorSink sink);
+  //Delivers everything queued so far on the calling thread.
+  void flush_errors();
+  //Errors lost because the queue was full.
+  uint64_t get_dropped_error_count();
+
+  //Queues an error without allocating, locking or doing I/O, so it is safe
+  //on an audio thread. Only the pointer to error_desc is kept - pass a
+  //string literal. context (a state name, a file name...) is copied. With
+  //throws set a std::system_error in alsa_category() is thrown as well.
+  void handle_error_code(int err_code, bool throws, const char* error_desc, const char* context = nullptr);
 }
 
 #endif
@@ -0,0 +1,70 @@
+#ifndef ALSAPLUSPLUS_EVENT_LOOP_HPP
+#define ALSAPLUSPLUS_EVENT_LOOP_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsaplusplus/pcm.hpp>
+
+extern "C"
+{
+#include <sys/epoll.h>
+}
+
+#include <atomic>
+#include <functional>
+
+namespace AlsaPlusPlus
+{
+  //Called when a device can accept (playback) or deliver (capture) at least
+  //avail_min frames. frames_ready is the current snd_pcm_avail_update count.
+  //A negative return value stops the current run_once/run call with that error.
+  typedef std::function<int(PCMDevice& device, snd_pcm_uframes_t frames_ready)> PCMEventHandler;
+
+  //Serves many PCM devices from one thread by multiplexing their poll
+  //descriptors over epoll. Handlers must consume the frames they are offered
+  //(or remove their device) - epoll is level-triggered, so a playback device
+  //left with free space will be reported again immediately.
+  class PCMEventLoop
+  {
+    public:
+      PCMEventLoop();
+      ~PCMEventLoop();
+
+      int add_device(PCMDevice& device, PCMEventHandler handler);
+      int remove_device(PCMDevice& device);
+      int run_once(int timeout_ms);
+      int run();
+      void stop();
+
+    private:
+      struct Registration;
+
+      struct DescriptorSlot
+      {
+        Registration* owner;
+        unsigned int index;
+      };
+
+      struct Registration
+      {
+        PCMDevice* device;
+        PCMEventHandler handler;
+        std::vector<struct pollfd> fds;
+        std::vector<DescriptorSlot> slots;
+        bool pending;
+        bool removed; //removed mid-dispatch; freed once run_once is done with it
+      };
+
+      int dispatch(Registration& reg);
+      void reap_removed();
+
+      int epoll_fd;
+      int wake_fd;
+      std::atomic<bool> running;
+      bool dispatching;
+      std::vector<std::unique_ptr<Registration>> registrations;
+      std::vector<Registration*> pending_registrations;
+      std::vector<struct epoll_event> events;
+  };
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef ALSAPLUSPLUS_FORMAT_TRAITS_HPP
+#define ALSAPLUSPLUS_FORMAT_TRAITS_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsa/pcm.h>
+
+#include <cstdint>
+
+namespace AlsaPlusPlus
+{
+  //24-bit sample in the low bits of a 32-bit container (SND_PCM_FORMAT_S24_LE).
+  //A distinct type so it can't be confused with a full-scale int32_t.
+  struct S24Sample
+  {
+    int32_t value;
+  };
+
+  //24-bit sample packed into three bytes (SND_PCM_FORMAT_S24_3LE), as stored
+  //in 24-bit WAV files.
+  struct S24PackedSample
+  {
+    uint8_t bytes[3];
+  };
+
+  static_assert(sizeof(S24Sample) == 4, "S24Sample must occupy a 32-bit container.");
+  static_assert(sizeof(S24PackedSample) == 3, "S24PackedSample must be exactly three bytes.");
+
+  //Format -> C++ sample type. Only formats with a specialization can be used
+  //with the typed transfer and conversion templates.
+  template <snd_pcm_format_t FORMAT>
+    struct FormatTraits
+  {
+    static constexpr bool supported = false;
+  };
+
+  //C++ sample type -> format. Every supported type maps to exactly one format.
+  template <typename SAMPLE_TYPE>
+    struct SampleFormat
+  {
+    static constexpr bool supported = false;
+    static constexpr snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
+  };
+
+  //The format for SAMPLE_TYPE, for the typed transfer templates. Refuses to
+  //compile for a type without one.
+  template <typename SAMPLE_TYPE>
+    constexpr snd_pcm_format_t sample_format()
+  {
+    static_assert(SampleFormat<SAMPLE_TYPE>::supported, "SAMPLE_TYPE has no matching ALSA format; use uint8_t, int16_t, S24Sample, S24PackedSample, int32_t or float.");
+    return SampleFormat<SAMPLE_TYPE>::format;
+  }
+
+  #define ALSAPLUSPLUS_SAMPLE_FORMAT(FORMAT, SAMPLE_TYPE, IS_FLOAT) \
+    template <> \
+      struct FormatTraits<FORMAT> \
+    { \
+      static constexpr bool supported = true; \
+      typedef SAMPLE_TYPE sample_type; \
+      static constexpr size_t physical_bytes = sizeof(SAMPLE_TYPE); \
+      static constexpr bool is_float = IS_FLOAT; \
+    }; \
+    template <> \
+      struct SampleFormat<SAMPLE_TYPE> \
+    { \
+      static constexpr bool supported = true; \
+      static constexpr snd_pcm_format_t format = FORMAT; \
+    };
+
+  ALSAPLUSPLUS_SAMPLE_FORMAT(SND_PCM_FORMAT_U8, uint8_t, false)
+  ALSAPLUSPLUS_SAMPLE_FORMAT(SND_PCM_FORMAT_S16_LE, int16_t, false)
+  ALSAPLUSPLUS_SAMPLE_FORMAT(SND_PCM_FORMAT_S24_LE, S24Sample, false)
+  ALSAPLUSPLUS_SAMPLE_FORMAT(SND_PCM_FORMAT_S24_3LE, S24PackedSample, false)
+  ALSAPLUSPLUS_SAMPLE_FORMAT(SND_PCM_FORMAT_S32_LE, int32_t, false)
+  ALSAPLUSPLUS_SAMPLE_FORMAT(SND_PCM_FORMAT_FLOAT_LE, float, true)
+
+  #undef ALSAPLUSPLUS_SAMPLE_FORMAT
+}
+
+#endif
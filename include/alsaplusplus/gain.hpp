@@ -0,0 +1,49 @@
+#ifndef ALSAPLUSPLUS_GAIN_HPP
+#define ALSAPLUSPLUS_GAIN_HPP
+
+#include <alsaplusplus/common.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace AlsaPlusPlus
+{
+  //Per-stream software volume for interleaved float frames. Gain changes
+  //ramp linearly over a given number of frames, starting at the first frame
+  //of the next process() call, so there is no zipper noise. The optional
+  //soft limiter bends peaks above the threshold smoothly toward full scale
+  //instead of letting integer conversion hard-clip them.
+  //set_* may be called from any one control thread while the audio thread
+  //runs process().
+  class GainStage
+  {
+    public:
+      GainStage();
+
+      void set_target(float gain, uint32_t ramp_frames);
+      float get_target() const;
+      void set_limiter(bool enabled, float threshold = 0.9f);
+
+      //True while process() would copy input to output unchanged.
+      bool is_bypassed() const;
+
+      //input and output may be the same buffer.
+      void process(const float* input, float* output, size_t frame_count, unsigned int channels);
+
+    private:
+      std::atomic<float> target_gain;
+      std::atomic<uint32_t> target_ramp_frames;
+      std::atomic<uint32_t> target_generation; //bumped after each set_target
+      std::atomic<bool> limiter_enabled;
+      std::atomic<float> limiter_threshold;
+
+      //Audio thread only
+      uint32_t applied_generation;
+      float current_gain;
+      float ramp_step;
+      float ramp_end;
+      uint32_t ramp_remaining;
+  };
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef ALSAPLUSPLUS_LATENCY_SOLVER_HPP
+#define ALSAPLUSPLUS_LATENCY_SOLVER_HPP
+
+#include <alsaplusplus/pcm_backend.hpp>
+
+namespace AlsaPlusPlus
+{
+  struct LatencyTarget
+  {
+    unsigned int latency_us; //buffer length to aim for - the worst-case queueing delay
+    unsigned int max_wakeups_per_s = 0; //cap on period interrupts per second; 0 for no cap
+    unsigned int min_periods = 2; //with fewer there is no time to refill while a period plays
+  };
+
+  struct BufferLayout
+  {
+    snd_pcm_uframes_t period_size;
+    unsigned int periods;
+  };
+
+  //Every period size and count inside ranges that keeps to the wakeup
+  //budget, best first: the buffer closest to the target latency, then the
+  //fewest wakeups. Besides the exact fit for each period count, the power
+  //of two sizes either side are offered, since many drivers only accept
+  //those - the caller tries the layouts in order until the device takes one.
+  std::vector<BufferLayout> rank_buffer_layouts(const HwRanges& ranges, const LatencyTarget& target);
+}
+
+#endif
@@ -16,6 +16,8 @@ namespace AlsaPlusPlus
       Mixer(std::string hw_device, std::string volume_element_name);
       ~Mixer();
 
+      //Both open the mixer on every call; for repeated lookups a scanned
+      //DeviceCatalog answers from memory.
       static bool device_exists(std::string hw_device);
       static bool element_exists(std::string hw_device, std::string element_name);
       float inc_vol_pct(float pct, snd_mixer_selem_channel_id_t channel = SND_MIXER_SCHN_MONO);
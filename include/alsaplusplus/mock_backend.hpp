@@ -0,0 +1,141 @@
+#ifndef ALSAPLUSPLUS_MOCK_BACKEND_HPP
+#define ALSAPLUSPLUS_MOCK_BACKEND_HPP
+
+#include <alsaplusplus/pcm_backend.hpp>
+
+#include <mutex>
+
+namespace AlsaPlusPlus
+{
+  struct MockBackendConfig
+  {
+    unsigned int min_rate_hz = 8000;
+    unsigned int max_rate_hz = 192000; //requested rates are clamped into this range
+    unsigned int max_channels = 8;
+    unsigned int periods = 4; //buffer size in periods when the caller doesn't ask for one
+    unsigned int min_periods = 2;
+    unsigned int max_periods = 32;
+    snd_pcm_uframes_t period_size = 0; //fixed period size; 0 takes the requested one
+    snd_pcm_uframes_t min_period_size = 16;
+    snd_pcm_uframes_t max_period_size = 16384;
+    bool period_pointer = true; //hardware pointer moves in whole periods, like an interrupt-driven driver
+    unsigned int wakeup_jitter_us = 0; //each wakeup lands up to this much late
+    uint32_t jitter_seed = 1;
+    bool nonblocking = false; //as if opened with SND_PCM_NONBLOCK
+  };
+
+  struct MockBackendStats
+  {
+    uint64_t transfer_calls; //writei/readi/writen/readn/mmap_commit
+    uint64_t frames_transferred;
+    uint64_t waits; //times a call had to block for the device
+    uint64_t wait_frames; //virtual time spent blocked, in frames
+    uint64_t starts;
+    uint64_t prepares;
+    uint64_t resumes;
+    uint64_t xruns;
+    uint64_t suspends;
+  };
+
+  //Simulated PCM device backed by plain memory, for measuring and testing
+  //the library without a sound card or kernel driver. Time is virtual:
+  //the hardware pointer advances only when a blocking call waits for it or
+  //when advance() is called, so a run is fully reproducible and never
+  //sleeps. Playback data is discarded; capture delivers silence.
+  //
+  //Supports every access type and any format with a defined physical
+  //width. Poll descriptors are not available, so EventLoop can't drive a
+  //mock device.
+  class MockBackend :
+    public PCMBackend
+  {
+    public:
+      MockBackend(snd_pcm_stream_t stream_type, MockBackendConfig config = MockBackendConfig());
+
+      //Moves the virtual clock forward; the device consumes or produces
+      //frames if it is running and stops with an xrun if they run out.
+      void advance(snd_pcm_uframes_t frames);
+      int inject_xrun();
+      //The next busy_resumes resume() calls return -EAGAIN. Afterwards the
+      //stream resumes where it was, or with resumable == false resume()
+      //fails with -ENOSYS and the stream must be prepared again.
+      int inject_suspend(unsigned int busy_resumes = 0, bool resumable = true);
+      uint64_t get_virtual_time_ns();
+      MockBackendStats get_stats();
+      void reset_stats();
+
+      std::string get_name() override;
+      snd_pcm_stream_t get_stream_direction() override;
+
+      int hw_params(HwConfig& config) override;
+      int hw_ranges(const HwConfig& config, HwRanges& ranges) override;
+      int hw_params_test(const HwConfig& config) override;
+      int sw_params_current(SwParams& params) override;
+      int sw_params(const SwParams& params) override;
+
+      snd_pcm_state_t state() override;
+      int prepare() override;
+      int start() override;
+      int resume() override;
+      int nonblock(int nonblock) override;
+      bool is_nonblocking() override;
+
+      snd_pcm_sframes_t avail_update() override;
+      snd_pcm_sframes_t avail() override;
+      int delay(snd_pcm_sframes_t& delay) override;
+      int wait(int timeout_ms) override;
+      int status(PCMStatus& status) override;
+
+      snd_pcm_sframes_t writei(const void* frames, snd_pcm_uframes_t frame_count) override;
+      snd_pcm_sframes_t readi(void* frames, snd_pcm_uframes_t frame_count) override;
+      snd_pcm_sframes_t writen(void** channels, snd_pcm_uframes_t frame_count) override;
+      snd_pcm_sframes_t readn(void** channels, snd_pcm_uframes_t frame_count) override;
+      int mmap_begin(const snd_pcm_channel_area_t** areas, snd_pcm_uframes_t* offset, snd_pcm_uframes_t* frames) override;
+      snd_pcm_sframes_t mmap_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames) override;
+
+      int poll_descriptors_count() override;
+      int poll_descriptors(struct pollfd* fds, unsigned int space) override;
+      int poll_descriptors_revents(struct pollfd* fds, unsigned int count, unsigned short* revents) override;
+
+    private:
+      void advance_clock(uint64_t frames);
+      snd_pcm_uframes_t ready_frames();
+      int state_error();
+      int block_until_ready(snd_pcm_uframes_t frames_needed, int64_t timeout_frames);
+      void do_start();
+      void period_size_range(snd_pcm_uframes_t& min_size, snd_pcm_uframes_t& max_size);
+      snd_pcm_sframes_t transfer(void* const* buffers, bool interleaved, snd_pcm_uframes_t frame_count);
+      void copy_frames(void* const* buffers, bool interleaved, snd_pcm_uframes_t device_offset, snd_pcm_uframes_t user_offset, snd_pcm_uframes_t frames);
+      uint32_t next_jitter_frames();
+
+      std::mutex device_mutex;
+      snd_pcm_stream_t stream_direction;
+      MockBackendConfig mock_config;
+      snd_pcm_state_t pcm_state;
+      snd_pcm_state_t suspended_state; //state to return to on resume
+      unsigned int busy_resume_count;
+      bool suspend_resumable;
+      snd_pcm_access_t access_type;
+      snd_pcm_format_t format_type;
+      unsigned int channels;
+      unsigned int sample_rate_hz;
+      size_t sample_bits; //physical width
+      snd_pcm_uframes_t period_size;
+      snd_pcm_uframes_t buffer_size;
+      SwParams current_sw_params;
+      std::vector<char> device_buffer;
+      std::vector<snd_pcm_channel_area_t> device_areas;
+      //Positions count frames since the last prepare and never wrap.
+      uint64_t hw_position; //exact device position
+      uint64_t hw_ptr; //position the application can see
+      uint64_t appl_ptr;
+      uint64_t start_position; //hw_position when the stream was started
+      uint64_t clock_frames; //virtual time since construction
+      uint64_t trigger_frames; //virtual time of the last start or stop
+      snd_pcm_uframes_t avail_max;
+      uint32_t jitter_state;
+      MockBackendStats stats;
+  };
+}
+
+#endif
@@ -2,8 +2,22 @@
 #define ALSAPLUSPLUS_PCM_HPP
 
 #include <alsaplusplus/common.hpp>
+#include <alsaplusplus/channel_matrix.hpp>
+#include <alsaplusplus/convert.hpp>
+#include <alsaplusplus/format_traits.hpp>
+#include <alsaplusplus/gain.hpp>
+#include <alsaplusplus/latency_solver.hpp>
+#include <alsaplusplus/pcm_backend.hpp>
+#include <alsaplusplus/planar_buffer.hpp>
+#include <alsaplusplus/realtime.hpp>
+#include <alsaplusplus/resampler.hpp>
+#include <alsaplusplus/ring_buffer.hpp>
 #include <alsa/pcm.h>
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 namespace AlsaPlusPlus
 {
   struct HwParams
@@ -13,50 +27,197 @@ namespace AlsaPlusPlus
     unsigned int sample_rate_hz;
     AudioChannels channels;
     unsigned int period_time_us;
+    unsigned int periods = 0; //periods per buffer; 0 leaves it to the device
+    unsigned int buffer_time_us = 0; //ignored when periods is set; 0 leaves it to the device
+    ResamplerQuality resampler_quality = ResamplerQuality::MEDIUM; //used by write_float if the device can't run at sample_rate_hz
+    //Let playback fall back to the nearest channel count the device offers.
+    //Only write_float remixes; every other transfer then takes frames at the
+    //device's count, as reported by get_hardware_params.
+    bool channel_mixing = false;
+  };
+
+  enum class XrunAction
+  {
+    DROP, //abandon the rest of the interrupted transfer
+    RESTART //continue the transfer from where it stopped
+  };
+
+  struct XrunPolicy
+  {
+    XrunAction action = XrunAction::DROP;
+    unsigned int resume_attempts = 3; //non-blocking snd_pcm_resume tries per recovery
+    snd_pcm_uframes_t silence_prefill_frames = 0; //silence queued after a playback underrun
+  };
+
+  struct XrunStats
+  {
+    uint64_t underruns;
+    uint64_t overruns;
+    uint64_t suspends;
+    uint64_t failed_recoveries;
   };
 
+  //Window into the device's DMA buffer obtained from snd_pcm_mmap_begin.
+  //Samples accessed through channel_data() are handed back with
+  //PCMDevice::mmap_commit without an intermediate copy.
+  struct MmapArea
+  {
+    const snd_pcm_channel_area_t* areas;
+    snd_pcm_uframes_t offset;
+    snd_pcm_uframes_t frames;
+
+    void* channel_data(unsigned int channel) const;
+  };
+
+  //Pull-mode render callback: fill frame_count interleaved frames in the
+  //configured stream format at frames. Return 0 to keep rendering, anything
+  //else to stop the render thread.
+  typedef std::function<int(void* frames, snd_pcm_uframes_t frame_count)> RenderCallback;
+
   class PCMDevice
   { 
     public:
-      PCMDevice(std::string hw_device, snd_pcm_stream_t stream_type);
-      ~PCMDevice();
+      PCMDevice(std::string hw_device, snd_pcm_stream_t stream_type, int mode = 0);
+      PCMDevice(std::unique_ptr<PCMBackend> pcm_backend);
       int set_hardware_params(HwParams params);
+      int configure_latency(HwParams& params, const LatencyTarget& target);
+      int get_software_params(SwParams& params);
+      int set_software_params(SwParams params);
+      snd_pcm_sframes_t mmap_begin(MmapArea& area, snd_pcm_uframes_t frames);
+      snd_pcm_sframes_t mmap_commit(const MmapArea& area, snd_pcm_uframes_t frames);
+      int start();
+      int recover(int error_code);
+      snd_pcm_stream_t get_stream_direction();
+      snd_pcm_sframes_t avail_update();
+      int poll_descriptors(std::vector<struct pollfd>& fds);
+      int poll_revents(struct pollfd* fds, unsigned int count, unsigned short& revents);
+      unsigned long get_frame_size();
+      snd_pcm_uframes_t get_period_size();
+      snd_pcm_uframes_t get_buffer_size();
+      HwParams get_hardware_params();
+      unsigned int get_stream_rate();
+      AudioChannels get_stream_channels();
+      int get_delay(snd_pcm_sframes_t& delay);
+      snd_pcm_sframes_t get_avail();
+      int get_status(PCMStatus& status);
+      void set_xrun_policy(XrunPolicy policy);
+      XrunPolicy get_xrun_policy();
+      XrunStats get_xrun_stats();
+      void reset_xrun_stats();
+      int wait_ready(int timeout_ms);
+      int set_nonblocking(bool enabled);
+      bool is_nonblocking();
 
     protected:
-      int xrun_recovery();
+      int apply_hardware_params(HwParams params, snd_pcm_uframes_t period_frames);
+      int xrun_recovery(int error_code);
+      int handle_xrun(int error_code, const char* error_desc);
+      void prefill_silence();
+      void prepare_silence_buffer();
+      snd_pcm_sframes_t transfer_interleaved(void* frames, snd_pcm_uframes_t frame_count);
+      snd_pcm_sframes_t transfer_noninterleaved(void* const* channels, snd_pcm_uframes_t frame_count);
+      snd_pcm_sframes_t mmap_transfer(void* const* buffers, snd_pcm_uframes_t frame_count);
+      template <typename AREA_CALLBACK>
+        snd_pcm_sframes_t mmap_loop(snd_pcm_uframes_t frame_count, AREA_CALLBACK transfer_area);
+      int wait_for_mmap_frames(snd_pcm_uframes_t frames_needed);
+      snd_pcm_sframes_t transfer_result(snd_pcm_uframes_t frames_done);
+      snd_pcm_sframes_t transfer_ring_regions(RingRegion* regions, snd_pcm_uframes_t max_frames);
+      int check_float_transfer();
 
       int err;
       std::string device_name;
+      snd_pcm_stream_t stream_direction;
       HwParams input_params;
-      snd_pcm_t* pcm_handle;
-      snd_pcm_hw_params_t* hw_params;
-      bool hw_params_alloc;
-      unsigned long frame_size; //bytes = channels * size(audio_data_struct)
+      std::unique_ptr<PCMBackend> backend;
+      bool nonblocking;
+      bool transfer_would_block; //the last transfer stopped early rather than block
+      unsigned long frame_size; //bytes = channels * physical width of the format in bytes
       snd_pcm_uframes_t period_size; //number of frames between interrupts
+      snd_pcm_uframes_t buffer_size; //frames in the whole ring buffer
+      std::vector<void*> channel_positions; //per-channel cursors for snd_pcm_writen/readn
+      XrunPolicy xrun_policy;
+      std::vector<char> silence_buffer;
+      snd_pcm_uframes_t silence_frames;
+      bool suspended;
+      std::atomic<uint64_t> underrun_count;
+      std::atomic<uint64_t> overrun_count;
+      std::atomic<uint64_t> suspend_count;
+      std::atomic<uint64_t> failed_recovery_count;
+      std::vector<char> conversion_buffer; //one period in the device format
+      unsigned int stream_rate_hz; //rate the caller supplies; differs from the device rate when resampling
+      Resampler resampler;
+      std::vector<float> resample_buffer; //one resampled period, interleaved
+      AudioChannels stream_channels; //channels the caller supplies; differs from the device when remixing
+      ChannelMatrix channel_matrix;
+      bool channel_mixing_active;
+      std::vector<float> mix_buffer; //one period remixed to the device channel count
+      std::vector<float> gain_buffer; //one period with software gain applied
   };
 
   class PCMPlayer :
     public PCMDevice
   {
     public:
-      PCMPlayer(std::string hw_device);
+      PCMPlayer(std::string hw_device, int mode = 0);
+      PCMPlayer(std::unique_ptr<PCMBackend> pcm_backend);
+      ~PCMPlayer();
 
+      int start_render(RenderCallback callback);
+      int start_render(RenderCallback callback, const RtThreadConfig& rt_config);
+      RtThreadStatus get_render_thread_status();
+      int stop_render();
+      bool is_rendering();
+      snd_pcm_sframes_t play_from_ring(FrameRingBuffer& ring, snd_pcm_uframes_t max_frames);
+      snd_pcm_sframes_t write_float(const float* samples, snd_pcm_uframes_t frame_count);
+      int set_channel_matrix(const ChannelMatrix& matrix);
+      void set_gain(float gain, uint32_t ramp_frames = 0);
+      float get_gain();
+      void set_limiter(bool enabled, float threshold = 0.9f);
+      void set_dither(bool enabled);
+
+      template <typename SAMPLE_TYPE>
+        snd_pcm_sframes_t write_interleaved(const SAMPLE_TYPE* frames, snd_pcm_uframes_t frame_count);
       template <typename SAMPLE_TYPE>
         int play_interleaved(const std::vector<SAMPLE_TYPE>& audio_samples);
       template <typename SAMPLE_TYPE>
-        int play_noninterleaved(const std::vector<std::vector<SAMPLE_TYPE>>& audio_streams);
+        snd_pcm_sframes_t write_noninterleaved(const SAMPLE_TYPE* const* channels, snd_pcm_uframes_t frame_count);
+      template <typename SAMPLE_TYPE>
+        int play_noninterleaved(const PlanarBuffer<SAMPLE_TYPE>& audio_buffer);
+
+    private:
+      int start_render_thread(RenderCallback callback, const RtThreadConfig* rt_config);
+      void render_loop();
+      int render_period();
+      snd_pcm_sframes_t write_device_float(const float* samples, snd_pcm_uframes_t frame_count);
+
+      RenderCallback render_callback;
+      std::thread render_thread;
+      std::atomic<bool> render_running;
+      RtThreadStatus render_thread_status;
+      DitherState dither_state;
+      bool dither_enabled;
+      GainStage gain_stage;
+      std::vector<char> render_buffer; //one period, used when MMAP is unavailable
   };
 
   class PCMRecorder :
     public PCMDevice
   {
     public:
-      PCMRecorder(std::string hw_device);
+      PCMRecorder(std::string hw_device, int mode = 0);
+      PCMRecorder(std::unique_ptr<PCMBackend> pcm_backend);
+
+      snd_pcm_sframes_t record_into_ring(FrameRingBuffer& ring, snd_pcm_uframes_t max_frames);
+      snd_pcm_sframes_t read_float(float* samples, snd_pcm_uframes_t frame_count);
 
       template <typename SAMPLE_TYPE>
-        int record_interleaved(const std::vector<SAMPLE_TYPE>& audio_samples);
+        snd_pcm_sframes_t read_interleaved(SAMPLE_TYPE* frames, snd_pcm_uframes_t frame_count);
+      template <typename SAMPLE_TYPE>
+        int record_interleaved(std::vector<SAMPLE_TYPE>& audio_samples);
+      template <typename SAMPLE_TYPE>
+        snd_pcm_sframes_t read_noninterleaved(SAMPLE_TYPE* const* channels, snd_pcm_uframes_t frame_count);
       template <typename SAMPLE_TYPE>
-        int record_noninterleaved(const std::vector<std::vector<SAMPLE_TYPE>>& audio_streams);
+        int record_noninterleaved(PlanarBuffer<SAMPLE_TYPE>& audio_buffer);
   };
 
   //Definitions of templated functions
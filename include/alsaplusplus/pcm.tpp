@@ -1,129 +1,343 @@
-//audio_samples.size() cannot exceed 4294967295
-//With 1-byte samples, that's ~4GB of audio.
-//With 2-byte samples, ~2GB.
-//With 4-byte samples, ~1GB.
-template <typename SAMPLE_TYPE>
-  int PCMPlayer::play_interleaved(const std::vector<SAMPLE_TYPE>& audio_samples)
+//The direct DMA transfer loop behind every MMAP transfer: waits until the
+//device has room (playback) or audio (capture), maps as much of the rest as
+//the ring allows and calls transfer_area(area, frames_done) to fill or
+//drain it before committing. A non-zero return from transfer_area ends the
+//transfer once its area is committed.
+//Returns the number of frames transferred, or a negative error code.
+template <typename AREA_CALLBACK>
+  snd_pcm_sframes_t PCMDevice::mmap_loop(snd_pcm_uframes_t frame_count, AREA_CALLBACK transfer_area)
 {
-  if (sizeof(SAMPLE_TYPE) == (snd_pcm_format_physical_width(input_params.format_type) / 8))
+  const char* error_desc = (stream_direction == SND_PCM_STREAM_PLAYBACK) ? "Write error." : "Read error.";
+  snd_pcm_uframes_t frames_done = 0;
+  transfer_would_block = false;
+
+  while (frames_done < frame_count)
   {
-    if (audio_samples.size() == 0)
+    snd_pcm_uframes_t remaining = frame_count - frames_done;
+    int next_step = 0;
+    int area_result = 0;
+    int step_err;
+    MmapArea area;
+    area.frames = remaining;
+
+    if ((step_err = wait_for_mmap_frames(remaining < period_size ? remaining : period_size)) < 0)
     {
-      handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Provided audio sample vector was empty.");
-      return static_cast<int>(std::errc::bad_file_descriptor);
+      next_step = handle_xrun(step_err, error_desc);
     }
+    else if ((step_err = backend->mmap_begin(&area.areas, &area.offset, &area.frames)) < 0)
+    {
+      next_step = handle_xrun(step_err, "Cannot map PCM buffer.");
+    }
+    else
+    {
+      area_result = transfer_area(static_cast<const MmapArea&>(area), frames_done);
+      snd_pcm_sframes_t committed = backend->mmap_commit(area.offset, area.frames);
 
-    snd_pcm_state_t hw_state = snd_pcm_state(pcm_handle);
+      if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != area.frames)
+      {
+        next_step = handle_xrun(committed >= 0 ? -EPIPE : committed, error_desc);
+      }
+      else
+      {
+        frames_done += area.frames;
+      }
+    }
 
-    if (hw_state == SND_PCM_STATE_PREPARED || hw_state == SND_PCM_STATE_RUNNING)
-    {
-      //Because frame size should equal sizeof(SAMPLE_TYPE),
-      //we should be able to send a number of SAMPLE_TYPE objects = period_size
-      //to fill the PCM buffer exactly.
-      unsigned int periods = static_cast<unsigned int>((float)audio_samples.size() / (float)period_size);
+    if (next_step < 0)
+      return next_step;
 
-      if (audio_samples.size() % periods > 0)
-        periods += 1;
+    if (next_step > 0 || area_result != 0)
+      break;
+  }
 
-      size_t frames_remaining = audio_samples.size();
-      size_t current_frames_written;
+  return transfer_result(frames_done);
+}
 
-      for (auto i = 0; i < periods; i++)
-      {
-        current_frames_written = 0;
-
-        //TODO: Support MMAP access.
-        if (frames_remaining < period_size)
-        {
-          while (current_frames_written < frames_remaining)
-          {
-            err = snd_pcm_writei(pcm_handle, (void*)&(audio_samples[i * period_size]), (frames_remaining - current_frames_written));
-
-            if (err == -EAGAIN)
-              continue; //Try again.
-
-            if (err < 0)
-            {
-              //Try to recover
-              int xrun_err;
-
-              if ((xrun_err = xrun_recovery()) < 0)
-              {
-                handle_error_code(xrun_err, false, "Read error.");
-                return err;
-              }
-              else
-              {
-                break; //Recovered - skip period.
-              }
-            }
-
-            current_frames_written -= err;
-            frames_remaining -= err;
-          }
-        }
-        else
-        {
-          while (current_frames_written < period_size)
-          {
-            err = snd_pcm_writei(pcm_handle, (void*)&(audio_samples[i * period_size]), (period_size - current_frames_written));
-
-            if (err == -EAGAIN)
-              continue; //Try again.
-
-            if (err < 0)
-            {
-              //Try to recover
-              int xrun_err;
-
-              if ((xrun_err = xrun_recovery()) < 0)
-              {
-                handle_error_code(xrun_err, false, "Read error.");
-                return err;
-              }
-              else
-              {
-                break; //Recovered - skip period.
-              }
-            }
-
-            current_frames_written -= err;
-            frames_remaining -= err;
-          }
-        }
-      }
+//Streams frame_count interleaved frames (channels samples each) from a
+//caller-owned buffer. May be called repeatedly on a running stream; nothing
+//is copied or allocated beyond the transfer into the device.
+//Returns the number of frames consumed, or a negative error code.
+template <typename SAMPLE_TYPE>
+  snd_pcm_sframes_t PCMPlayer::write_interleaved(const SAMPLE_TYPE* frames, snd_pcm_uframes_t frame_count)
+{
+  //The type fixes the format at compile time, so this is one comparison
+  //rather than a width lookup, and it tells S24_LE and S32_LE apart.
+  if (sample_format<SAMPLE_TYPE>() != input_params.format_type)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The datatype of the provided audio buffer did not match the configured stream format.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (frames == nullptr || frame_count == 0)
+    return 0;
+
+  snd_pcm_state_t hw_state = backend->state();
+
+  //XRUN and SUSPENDED are let through so the transfer can recover them.
+  if (hw_state == SND_PCM_STATE_OPEN || hw_state == SND_PCM_STATE_SETUP || hw_state == SND_PCM_STATE_DISCONNECTED)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not start playback - device is not configured.", snd_pcm_state_name(hw_state));
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  //A recovered xrun drops the remainder of the call, so report everything
+  //as consumed unless the device failed outright. A non-blocking device
+  //that filled up reports only what it took, or -EAGAIN.
+  snd_pcm_sframes_t written = transfer_interleaved(const_cast<SAMPLE_TYPE*>(frames), frame_count);
+
+  if (written < 0)
+    return written;
+
+  return transfer_would_block ? written : frame_count;
+}
+
+//Returns 0 once every sample has been queued, or a negative error code.
+template <typename SAMPLE_TYPE>
+  int PCMPlayer::play_interleaved(const std::vector<SAMPLE_TYPE>& audio_samples)
+{
+  if (audio_samples.size() == 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Provided audio sample vector was empty.");
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  //The vector holds samples, one per channel per frame.
+  //Plays the whole vector even on a non-blocking device, waiting for room
+  //whenever it fills up.
+  snd_pcm_uframes_t frame_count = audio_samples.size() / static_cast<int>(input_params.channels);
+  snd_pcm_uframes_t frames_done = 0;
+
+  while (frames_done < frame_count)
+  {
+    snd_pcm_sframes_t written = write_interleaved(audio_samples.data() + (frames_done * static_cast<int>(input_params.channels)), frame_count - frames_done);
+
+    if (written == -EAGAIN)
+    {
+      if ((err = wait_ready(-1)) < 0)
+        return err;
+
+      continue;
     }
+
+    if (written < 0)
+      return written;
+
+    if (transfer_would_block)
+      frames_done += written;
     else
+      frames_done = frame_count;
+  }
+
+  return 0;
+}
+
+//Streams frame_count frames from one buffer per channel, via snd_pcm_writen
+//or the MMAP_NONINTERLEAVED area, without an interleave pass.
+//Returns the number of frames consumed, or a negative error code.
+template <typename SAMPLE_TYPE>
+  snd_pcm_sframes_t PCMPlayer::write_noninterleaved(const SAMPLE_TYPE* const* channels, snd_pcm_uframes_t frame_count)
+{
+  if (sample_format<SAMPLE_TYPE>() != input_params.format_type)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The datatype of the provided audio buffer did not match the configured stream format.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (input_params.access_type != SND_PCM_ACCESS_RW_NONINTERLEAVED && input_params.access_type != SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "PCM device was not configured for non-interleaved access.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (channels == nullptr || frame_count == 0)
+    return 0;
+
+  snd_pcm_state_t hw_state = backend->state();
+
+  //XRUN and SUSPENDED are let through so the transfer can recover them.
+  if (hw_state == SND_PCM_STATE_OPEN || hw_state == SND_PCM_STATE_SETUP || hw_state == SND_PCM_STATE_DISCONNECTED)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not start playback - device is not configured.", snd_pcm_state_name(hw_state));
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  //The transfer helpers are shared with capture and so take mutable
+  //pointers; playback only ever reads through them.
+  snd_pcm_sframes_t written = transfer_noninterleaved(reinterpret_cast<void* const*>(const_cast<SAMPLE_TYPE* const*>(channels)), frame_count);
+
+  if (written < 0)
+    return written;
+
+  return transfer_would_block ? written : frame_count;
+}
+
+//Returns 0 once every frame has been queued, or a negative error code.
+template <typename SAMPLE_TYPE>
+  int PCMPlayer::play_noninterleaved(const PlanarBuffer<SAMPLE_TYPE>& audio_buffer)
+{
+  if (audio_buffer.frames() == 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Provided planar audio buffer was empty.");
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  if (audio_buffer.channels() != static_cast<unsigned int>(input_params.channels))
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The channel count of the provided planar buffer did not match the configured stream.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  //Cursors for resubmitting the rest after a partial non-blocking write;
+  //channel_positions can't serve, the transfer itself rewrites it.
+  const SAMPLE_TYPE* positions[ChannelMatrix::MAX_CHANNELS];
+
+  if (audio_buffer.channels() > ChannelMatrix::MAX_CHANNELS)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Too many channels in the provided planar buffer.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  for (unsigned int c = 0; c < audio_buffer.channels(); c++)
+    positions[c] = audio_buffer.channel_pointers()[c];
+
+  snd_pcm_uframes_t frames_done = 0;
+
+  while (frames_done < audio_buffer.frames())
+  {
+    snd_pcm_sframes_t written = write_noninterleaved(positions, audio_buffer.frames() - frames_done);
+
+    if (written == -EAGAIN)
     {
-      std::ostringstream oss;
-      oss << "Could not start playback - device in state " << snd_pcm_state_name(hw_state) << " instead of SND_PCM_STATE_PREPARED or SND_PCM_STATE_RUNNING.";
-      handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, oss.str());
-      return static_cast<int>(std::errc::bad_file_descriptor);
+      if ((err = wait_ready(-1)) < 0)
+        return err;
+
+      continue;
     }
+
+    if (written < 0)
+      return written;
+
+    if (!transfer_would_block)
+      break;
+
+    frames_done += written;
+
+    for (unsigned int c = 0; c < audio_buffer.channels(); c++)
+      positions[c] += written;
   }
-  else
+
+  return 0;
+}
+
+//Captures frame_count interleaved frames into a caller-owned buffer. Meant
+//to be called repeatedly on a running stream with the same preallocated
+//buffer, so capture does no allocation per period.
+//Returns the number of frames actually captured (fewer than requested if an
+//overrun was recovered mid-read or a non-blocking device ran dry), or a
+//negative error code - -EAGAIN if a non-blocking device had nothing yet.
+template <typename SAMPLE_TYPE>
+  snd_pcm_sframes_t PCMRecorder::read_interleaved(SAMPLE_TYPE* frames, snd_pcm_uframes_t frame_count)
+{
+  if (sample_format<SAMPLE_TYPE>() != input_params.format_type)
   {
-    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The datatype of the provided audio vector did not match the configured stream format.");
-    return static_cast<int>(std::errc::invalid_argument);
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The datatype of the provided audio buffer did not match the configured stream format.");
+    return -static_cast<int>(std::errc::invalid_argument);
   }
 
-  return 0;
+  if (frames == nullptr || frame_count == 0)
+    return 0;
+
+  snd_pcm_state_t hw_state = backend->state();
+
+  //XRUN and SUSPENDED are let through so the transfer can recover them.
+  if (hw_state == SND_PCM_STATE_OPEN || hw_state == SND_PCM_STATE_SETUP || hw_state == SND_PCM_STATE_DISCONNECTED)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not start capture - device is not configured.", snd_pcm_state_name(hw_state));
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  return transfer_interleaved(frames, frame_count);
 }
 
+//Fills audio_samples to its current size, which must be a whole number of
+//frames. The vector is never resized, so callers size it once up front and
+//reuse it. Returns 0, or a negative error code.
 template <typename SAMPLE_TYPE>
-  int PCMPlayer::play_noninterleaved(const std::vector<std::vector<SAMPLE_TYPE>>& audio_streams)
+  int PCMRecorder::record_interleaved(std::vector<SAMPLE_TYPE>& audio_samples)
 {
+  size_t channels = static_cast<int>(input_params.channels);
+  snd_pcm_uframes_t frame_count = audio_samples.size() / channels;
+
+  if (frame_count == 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Provided audio sample vector was too small to hold a frame.");
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  if (audio_samples.size() % channels != 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Provided audio sample vector does not hold a whole number of frames.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  snd_pcm_sframes_t captured = read_interleaved(audio_samples.data(), frame_count);
+
+  if (captured < 0)
+    return captured;
+
   return 0;
 }
 
 template <typename SAMPLE_TYPE>
-  int PCMRecorder::record_interleaved(const std::vector<SAMPLE_TYPE>& audio_samples)
+  snd_pcm_sframes_t PCMRecorder::read_noninterleaved(SAMPLE_TYPE* const* channels, snd_pcm_uframes_t frame_count)
 {
-  return 0;
+  if (sample_format<SAMPLE_TYPE>() != input_params.format_type)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The datatype of the provided audio buffer did not match the configured stream format.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (input_params.access_type != SND_PCM_ACCESS_RW_NONINTERLEAVED && input_params.access_type != SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "PCM device was not configured for non-interleaved access.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (channels == nullptr || frame_count == 0)
+    return 0;
+
+  snd_pcm_state_t hw_state = backend->state();
+
+  //XRUN and SUSPENDED are let through so the transfer can recover them.
+  if (hw_state == SND_PCM_STATE_OPEN || hw_state == SND_PCM_STATE_SETUP || hw_state == SND_PCM_STATE_DISCONNECTED)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not start capture - device is not configured.", snd_pcm_state_name(hw_state));
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  return transfer_noninterleaved(reinterpret_cast<void* const*>(channels), frame_count);
 }
 
+//Returns 0, or a negative error code.
 template <typename SAMPLE_TYPE>
-  int PCMRecorder::record_noninterleaved(const std::vector<std::vector<SAMPLE_TYPE>>& audio_samples)
+  int PCMRecorder::record_noninterleaved(PlanarBuffer<SAMPLE_TYPE>& audio_buffer)
 {
+  if (audio_buffer.frames() == 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Provided planar audio buffer was empty.");
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  if (audio_buffer.channels() != static_cast<unsigned int>(input_params.channels))
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The channel count of the provided planar buffer did not match the configured stream.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  snd_pcm_sframes_t captured = read_noninterleaved(audio_buffer.channel_pointers(), audio_buffer.frames());
+
+  if (captured < 0)
+    return captured;
+
   return 0;
 }
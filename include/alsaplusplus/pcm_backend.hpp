@@ -0,0 +1,171 @@
+#ifndef ALSAPLUSPLUS_PCM_BACKEND_HPP
+#define ALSAPLUSPLUS_PCM_BACKEND_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsa/pcm.h>
+
+#include <string>
+
+namespace AlsaPlusPlus
+{
+  //Software parameters, applied after set_hardware_params. All thresholds
+  //are in frames. Read the current values with get_software_params and
+  //adjust only what needs tuning.
+  struct SwParams
+  {
+    snd_pcm_uframes_t start_threshold; //frames queued before playback auto-starts
+    snd_pcm_uframes_t stop_threshold; //stop with an xrun once avail reaches this
+    snd_pcm_uframes_t avail_min; //wake poll/wait once this many frames are ready
+    snd_pcm_uframes_t silence_threshold; //fill silence when this little is queued
+    snd_pcm_uframes_t silence_size; //how much silence to fill
+    bool period_event; //wake on every period even if avail_min is larger
+    bool timestamps; //record a timestamp with every hardware pointer update
+  };
+
+  //Snapshot from snd_pcm_status. Timestamps use the clock selected by the
+  //device (monotonic on current kernels); audio_timestamp is the
+  //hardware-reported audio position when the driver supports it.
+  struct PCMStatus
+  {
+    snd_pcm_state_t state;
+    snd_htimestamp_t trigger_timestamp; //when the stream was started or stopped
+    snd_htimestamp_t timestamp; //when this status was taken
+    snd_htimestamp_t audio_timestamp;
+    snd_pcm_sframes_t delay;
+    snd_pcm_uframes_t avail;
+    snd_pcm_uframes_t avail_max; //largest avail since the last status call
+    snd_pcm_uframes_t overrange;
+  };
+
+  //Hardware configuration handed to PCMBackend::hw_params. Fields marked
+  //in/out are replaced with what the device actually accepted; a zero
+  //request leaves that parameter to the device.
+  struct HwConfig
+  {
+    snd_pcm_access_t access_type;
+    snd_pcm_format_t format_type;
+    unsigned int channels; //in/out
+    bool channels_near; //settle for the nearest channel count instead of failing
+    unsigned int sample_rate_hz; //in/out
+    unsigned int period_time_us; //in/out, ignored when period_size is requested
+    snd_pcm_uframes_t period_size; //in/out
+    unsigned int periods; //in/out
+    unsigned int buffer_time_us; //in/out, ignored when periods is requested
+    snd_pcm_uframes_t buffer_size; //out
+  };
+
+  //What a device still allows once access, format, channels and rate are
+  //fixed. Sizes are in frames.
+  struct HwRanges
+  {
+    unsigned int sample_rate_hz; //the rate the ranges apply to
+    snd_pcm_uframes_t period_size_min;
+    snd_pcm_uframes_t period_size_max;
+    unsigned int periods_min;
+    unsigned int periods_max;
+    snd_pcm_uframes_t buffer_size_min;
+    snd_pcm_uframes_t buffer_size_max;
+  };
+
+  //The device end of a PCMDevice. Every call mirrors the snd_pcm_* function
+  //of the same name - same arguments minus the handle, same return values
+  //and negative error codes - so PCMDevice's transfer and recovery logic
+  //runs unchanged against ALSA or against a simulated device.
+  class PCMBackend
+  {
+    public:
+      virtual ~PCMBackend() {}
+
+      virtual std::string get_name() = 0;
+      virtual snd_pcm_stream_t get_stream_direction() = 0;
+
+      virtual int hw_params(HwConfig& config) = 0;
+      //Narrows the configuration space by config's access, format,
+      //channels and rate, and reports what is left, without applying it.
+      virtual int hw_ranges(const HwConfig& config, HwRanges& ranges) = 0;
+      //0 if the device accepts exactly config.period_size frames times
+      //config.periods (snd_pcm_hw_params_test_*), a negative code if not.
+      virtual int hw_params_test(const HwConfig& config) = 0;
+      virtual int sw_params_current(SwParams& params) = 0;
+      virtual int sw_params(const SwParams& params) = 0;
+
+      virtual snd_pcm_state_t state() = 0;
+      virtual int prepare() = 0;
+      virtual int start() = 0;
+      virtual int resume() = 0;
+      virtual int nonblock(int nonblock) = 0;
+      virtual bool is_nonblocking() = 0;
+
+      virtual snd_pcm_sframes_t avail_update() = 0;
+      virtual snd_pcm_sframes_t avail() = 0;
+      virtual int delay(snd_pcm_sframes_t& delay) = 0;
+      virtual int wait(int timeout_ms) = 0;
+      virtual int status(PCMStatus& status) = 0;
+
+      virtual snd_pcm_sframes_t writei(const void* frames, snd_pcm_uframes_t frame_count) = 0;
+      virtual snd_pcm_sframes_t readi(void* frames, snd_pcm_uframes_t frame_count) = 0;
+      virtual snd_pcm_sframes_t writen(void** channels, snd_pcm_uframes_t frame_count) = 0;
+      virtual snd_pcm_sframes_t readn(void** channels, snd_pcm_uframes_t frame_count) = 0;
+      virtual int mmap_begin(const snd_pcm_channel_area_t** areas, snd_pcm_uframes_t* offset, snd_pcm_uframes_t* frames) = 0;
+      virtual snd_pcm_sframes_t mmap_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames) = 0;
+
+      virtual int poll_descriptors_count() = 0;
+      virtual int poll_descriptors(struct pollfd* fds, unsigned int space) = 0;
+      virtual int poll_descriptors_revents(struct pollfd* fds, unsigned int count, unsigned short* revents) = 0;
+  };
+
+  //A real device opened with snd_pcm_open.
+  class AlsaBackend :
+    public PCMBackend
+  {
+    public:
+      AlsaBackend(std::string hw_device, snd_pcm_stream_t stream_type, int mode = 0);
+      AlsaBackend(const AlsaBackend&) = delete;
+      AlsaBackend& operator=(const AlsaBackend&) = delete;
+      ~AlsaBackend();
+
+      std::string get_name() override;
+      snd_pcm_stream_t get_stream_direction() override;
+
+      int hw_params(HwConfig& config) override;
+      int hw_ranges(const HwConfig& config, HwRanges& ranges) override;
+      int hw_params_test(const HwConfig& config) override;
+      int sw_params_current(SwParams& params) override;
+      int sw_params(const SwParams& params) override;
+
+      snd_pcm_state_t state() override;
+      int prepare() override;
+      int start() override;
+      int resume() override;
+      int nonblock(int nonblock) override;
+      bool is_nonblocking() override;
+
+      snd_pcm_sframes_t avail_update() override;
+      snd_pcm_sframes_t avail() override;
+      int delay(snd_pcm_sframes_t& delay) override;
+      int wait(int timeout_ms) override;
+      int status(PCMStatus& status) override;
+
+      snd_pcm_sframes_t writei(const void* frames, snd_pcm_uframes_t frame_count) override;
+      snd_pcm_sframes_t readi(void* frames, snd_pcm_uframes_t frame_count) override;
+      snd_pcm_sframes_t writen(void** channels, snd_pcm_uframes_t frame_count) override;
+      snd_pcm_sframes_t readn(void** channels, snd_pcm_uframes_t frame_count) override;
+      int mmap_begin(const snd_pcm_channel_area_t** areas, snd_pcm_uframes_t* offset, snd_pcm_uframes_t* frames) override;
+      snd_pcm_sframes_t mmap_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames) override;
+
+      int poll_descriptors_count() override;
+      int poll_descriptors(struct pollfd* fds, unsigned int space) override;
+      int poll_descriptors_revents(struct pollfd* fds, unsigned int count, unsigned short* revents) override;
+
+    private:
+      int restrict_hw_params(snd_pcm_hw_params_t* hw_params, HwConfig& config);
+
+      int err;
+      std::string device_name;
+      snd_pcm_stream_t stream_direction;
+      snd_pcm_t* pcm_handle;
+      bool nonblocking;
+  };
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ALSAPLUSPLUS_PLANAR_BUFFER_HPP
+#define ALSAPLUSPLUS_PLANAR_BUFFER_HPP
+
+#include <alsaplusplus/common.hpp>
+
+#include <cstdlib>
+
+namespace AlsaPlusPlus
+{
+  //Alignment of every channel plane, in bytes. One cache line keeps
+  //channels from sharing lines and suits aligned SIMD loads.
+  constexpr size_t PLANAR_BUFFER_ALIGNMENT = 64;
+
+  //Non-interleaved audio held in a single contiguous, cache-aligned
+  //allocation. Channel c starts at data() + c * stride(); stride() is the
+  //frame count rounded up so every plane begins on an aligned boundary.
+  template <typename SAMPLE_TYPE>
+    class PlanarBuffer
+  {
+    public:
+      PlanarBuffer(unsigned int channel_count, size_t frame_count);
+      PlanarBuffer(PlanarBuffer&& other) noexcept;
+      PlanarBuffer& operator=(PlanarBuffer&& other) noexcept;
+      PlanarBuffer(const PlanarBuffer&) = delete;
+      PlanarBuffer& operator=(const PlanarBuffer&) = delete;
+      ~PlanarBuffer();
+
+      SAMPLE_TYPE* channel(unsigned int index);
+      const SAMPLE_TYPE* channel(unsigned int index) const;
+      const SAMPLE_TYPE* const* channel_pointers() const;
+      SAMPLE_TYPE* const* channel_pointers();
+      SAMPLE_TYPE* data();
+      const SAMPLE_TYPE* data() const;
+
+      unsigned int channels() const;
+      size_t frames() const;
+      size_t stride() const;
+
+    private:
+      unsigned int channel_count;
+      size_t frame_count;
+      size_t channel_stride; //samples between the starts of adjacent channels
+      SAMPLE_TYPE* samples;
+      std::vector<SAMPLE_TYPE*> planes;
+  };
+
+  //Definitions of templated functions
+  #include <alsaplusplus/planar_buffer.tpp>
+}
+
+#endif
@@ -0,0 +1,124 @@
+template <typename SAMPLE_TYPE>
+  PlanarBuffer<SAMPLE_TYPE>::PlanarBuffer(unsigned int channel_count, size_t frame_count) :
+  channel_count(channel_count),
+  frame_count(frame_count),
+  samples(nullptr)
+{
+  //Planes are rounded up to a whole number of alignment units that is also
+  //a whole number of samples - for 3-byte samples that is 64 frames, not 64
+  //bytes. size_alignment is the largest power of two dividing the size.
+  constexpr size_t size_alignment = sizeof(SAMPLE_TYPE) & (~sizeof(SAMPLE_TYPE) + 1);
+  constexpr size_t stride_unit = (size_alignment < PLANAR_BUFFER_ALIGNMENT) ? PLANAR_BUFFER_ALIGNMENT / size_alignment : 1;
+
+  channel_stride = ((frame_count + stride_unit - 1) / stride_unit) * stride_unit;
+  size_t plane_bytes = channel_stride * sizeof(SAMPLE_TYPE);
+
+  void* block = nullptr;
+
+  if (plane_bytes * channel_count > 0)
+  {
+    if (posix_memalign(&block, PLANAR_BUFFER_ALIGNMENT, plane_bytes * channel_count) != 0)
+      handle_error_code(static_cast<int>(std::errc::not_enough_memory), true, "Cannot allocate planar audio buffer.");
+
+    memset(block, 0, plane_bytes * channel_count);
+  }
+
+  samples = static_cast<SAMPLE_TYPE*>(block);
+
+  for (unsigned int c = 0; c < channel_count; c++)
+    planes.push_back(samples + (c * channel_stride));
+}
+
+template <typename SAMPLE_TYPE>
+  PlanarBuffer<SAMPLE_TYPE>::PlanarBuffer(PlanarBuffer&& other) noexcept :
+  channel_count(other.channel_count),
+  frame_count(other.frame_count),
+  channel_stride(other.channel_stride),
+  samples(other.samples),
+  planes(std::move(other.planes))
+{
+  other.samples = nullptr;
+  other.channel_count = 0;
+  other.frame_count = 0;
+}
+
+template <typename SAMPLE_TYPE>
+  PlanarBuffer<SAMPLE_TYPE>& PlanarBuffer<SAMPLE_TYPE>::operator=(PlanarBuffer&& other) noexcept
+{
+  if (this != &other)
+  {
+    free(samples);
+
+    channel_count = other.channel_count;
+    frame_count = other.frame_count;
+    channel_stride = other.channel_stride;
+    samples = other.samples;
+    planes = std::move(other.planes);
+
+    other.samples = nullptr;
+    other.channel_count = 0;
+    other.frame_count = 0;
+  }
+
+  return *this;
+}
+
+template <typename SAMPLE_TYPE>
+  PlanarBuffer<SAMPLE_TYPE>::~PlanarBuffer()
+{
+  free(samples);
+}
+
+template <typename SAMPLE_TYPE>
+  SAMPLE_TYPE* PlanarBuffer<SAMPLE_TYPE>::channel(unsigned int index)
+{
+  return planes[index];
+}
+
+template <typename SAMPLE_TYPE>
+  const SAMPLE_TYPE* PlanarBuffer<SAMPLE_TYPE>::channel(unsigned int index) const
+{
+  return planes[index];
+}
+
+template <typename SAMPLE_TYPE>
+  const SAMPLE_TYPE* const* PlanarBuffer<SAMPLE_TYPE>::channel_pointers() const
+{
+  return planes.data();
+}
+
+template <typename SAMPLE_TYPE>
+  SAMPLE_TYPE* const* PlanarBuffer<SAMPLE_TYPE>::channel_pointers()
+{
+  return planes.data();
+}
+
+template <typename SAMPLE_TYPE>
+  SAMPLE_TYPE* PlanarBuffer<SAMPLE_TYPE>::data()
+{
+  return samples;
+}
+
+template <typename SAMPLE_TYPE>
+  const SAMPLE_TYPE* PlanarBuffer<SAMPLE_TYPE>::data() const
+{
+  return samples;
+}
+
+template <typename SAMPLE_TYPE>
+  unsigned int PlanarBuffer<SAMPLE_TYPE>::channels() const
+{
+  return channel_count;
+}
+
+template <typename SAMPLE_TYPE>
+  size_t PlanarBuffer<SAMPLE_TYPE>::frames() const
+{
+  return frame_count;
+}
+
+template <typename SAMPLE_TYPE>
+  size_t PlanarBuffer<SAMPLE_TYPE>::stride() const
+{
+  return channel_stride;
+}
@@ -0,0 +1,43 @@
+#ifndef ALSAPLUSPLUS_REALTIME_HPP
+#define ALSAPLUSPLUS_REALTIME_HPP
+
+#include <alsaplusplus/common.hpp>
+
+#include <functional>
+#include <thread>
+
+extern "C"
+{
+#include <sched.h>
+}
+
+namespace AlsaPlusPlus
+{
+  //Requested scheduling for an audio thread. Nothing here is applied unless
+  //a config is passed explicitly - the library never promotes threads itself.
+  struct RtThreadConfig
+  {
+    int policy = SCHED_FIFO; //SCHED_FIFO, SCHED_RR or SCHED_OTHER
+    int priority = 70;
+    std::vector<int> cpus; //CPUs to pin to; empty leaves affinity alone
+    bool lock_memory = true; //mlockall(MCL_CURRENT | MCL_FUTURE), process-wide
+    size_t prefault_stack_bytes = 256 * 1024;
+  };
+
+  //What the thread actually got. Missing privileges (no CAP_SYS_NICE, low
+  //RLIMIT_RTPRIO or RLIMIT_MEMLOCK) degrade individual items instead of failing.
+  struct RtThreadStatus
+  {
+    int policy = SCHED_OTHER;
+    int priority = 0;
+    bool priority_clamped = false; //priority lowered to fit RLIMIT_RTPRIO
+    bool affinity_set = false;
+    bool memory_locked = false;
+    bool stack_prefaulted = false;
+  };
+
+  RtThreadStatus apply_realtime_config(const RtThreadConfig& config);
+  std::thread spawn_realtime_thread(const RtThreadConfig& config, std::function<void()> body, RtThreadStatus& status);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ALSAPLUSPLUS_RESAMPLER_HPP
+#define ALSAPLUSPLUS_RESAMPLER_HPP
+
+#include <alsaplusplus/common.hpp>
+
+#include <cstdint>
+
+namespace AlsaPlusPlus
+{
+  enum class ResamplerQuality
+  {
+    DISABLED, //never resample; a rate mismatch only warns
+    FAST, //16 taps per phase, ~60 dB stopband
+    MEDIUM, //32 taps per phase, ~80 dB stopband
+    HIGH //64 taps per phase, ~100 dB stopband
+  };
+
+  //Streaming polyphase windowed-sinc sample-rate converter for interleaved
+  //float frames. The ratio is kept exact as output_rate/input_rate reduced
+  //to L/M, with one Kaiser-windowed filter phase per output sub-position, so
+  //there is no drift over long streams. All storage is sized in configure();
+  //process() does not allocate.
+  class Resampler
+  {
+    public:
+      Resampler();
+
+      int configure(unsigned int input_rate, unsigned int output_rate, unsigned int channels, ResamplerQuality quality, size_t max_input_frames);
+      void reset(); //Clears the filter history, e.g. between unrelated streams.
+
+      //Consumes input_frames (at most max_input_frames) and writes whatever
+      //output frames are now complete. Returns the number of frames written.
+      size_t process(const float* input, size_t input_frames, float* output);
+
+      size_t max_output_frames(size_t input_frames) const;
+      bool active() const;
+      unsigned int latency_frames() const; //group delay, in input frames
+
+    private:
+      unsigned int channel_count;
+      unsigned int upsample; //L
+      unsigned int downsample; //M
+      unsigned int taps;
+      size_t max_input;
+      size_t plane_frames; //taps - 1 carried-over frames plus max_input
+      size_t buffered_frames;
+      uint64_t position; //next output, in 1/L input frames from the plane start
+      std::vector<float> coefficients; //L rows of taps each
+      std::vector<float> history; //one plane of plane_frames per channel
+      bool enabled;
+  };
+}
+
+#endif
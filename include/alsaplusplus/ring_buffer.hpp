@@ -0,0 +1,68 @@
+#ifndef ALSAPLUSPLUS_RING_BUFFER_HPP
+#define ALSAPLUSPLUS_RING_BUFFER_HPP
+
+#include <alsaplusplus/common.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace AlsaPlusPlus
+{
+  //Contiguous piece of a FrameRingBuffer. A read or write that wraps the end
+  //of storage is described by two regions; second.frames is 0 otherwise.
+  struct RingRegion
+  {
+    char* data;
+    size_t frames;
+  };
+
+  //Wait-free single-producer/single-consumer queue of interleaved frames.
+  //Capacity is a whole number of device periods and the storage is
+  //cache-aligned, so the audio thread always moves full periods without
+  //taking a lock. Exactly one thread may write and exactly one may read.
+  class FrameRingBuffer
+  {
+    public:
+      FrameRingBuffer(size_t frame_size, size_t period_frames, size_t periods);
+      FrameRingBuffer(const FrameRingBuffer&) = delete;
+      FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+      ~FrameRingBuffer();
+
+      //Producer side
+      size_t write(const void* frames, size_t frame_count);
+      size_t write_available() const;
+      size_t write_regions(RingRegion& first, RingRegion& second);
+      void commit_write(size_t frame_count);
+
+      //Consumer side
+      size_t read(void* frames, size_t frame_count);
+      size_t read_available() const;
+      size_t read_regions(RingRegion& first, RingRegion& second);
+      void commit_read(size_t frame_count);
+
+      size_t capacity() const;
+      size_t frame_bytes() const;
+      size_t period_frames() const;
+      void reset(); //Only while neither side is active.
+
+    private:
+      size_t map_write_regions(RingRegion& first, RingRegion& second, size_t frames_wanted);
+      size_t map_read_regions(RingRegion& first, RingRegion& second, size_t frames_wanted);
+
+      size_t frame_size;
+      size_t period_size;
+      size_t capacity_frames;
+      char* storage;
+
+      //Free-running frame counters, each on its own cache line so producer
+      //and consumer do not false-share. The cached_* copies are private to
+      //one side and spare it the other side's line while they already show
+      //as much as the caller wants; below that the real index is reloaded.
+      alignas(64) std::atomic<uint64_t> write_index;
+      uint64_t cached_read_index;
+      alignas(64) std::atomic<uint64_t> read_index;
+      uint64_t cached_write_index;
+  };
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef ALSAPLUSPLUS_WAV_FILE_HPP
+#define ALSAPLUSPLUS_WAV_FILE_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsaplusplus/format_traits.hpp>
+#include <alsa/pcm.h>
+
+#include <cstdint>
+#include <string>
+
+namespace AlsaPlusPlus
+{
+  //Contents of the fmt chunk, with WAVE_FORMAT_EXTENSIBLE resolved to the
+  //sub-format it wraps.
+  struct WavFormat
+  {
+    uint16_t format_tag; //1 = integer PCM, 3 = IEEE float
+    uint16_t channels;
+    uint32_t sample_rate_hz;
+    uint16_t block_align; //bytes per frame
+    uint16_t bits_per_sample; //container width
+    uint16_t valid_bits; //significant bits, from the extensible header when present
+    uint32_t channel_mask; //speaker positions, 0 if not given
+    snd_pcm_format_t pcm_format; //SND_PCM_FORMAT_UNKNOWN if ALSA has no match
+  };
+
+  //Where the audio sits, as byte offsets from the start of the file.
+  struct WavLayout
+  {
+    WavFormat format;
+    uint64_t data_offset;
+    uint64_t data_bytes; //WAV_DATA_SIZE_UNKNOWN if the header doesn't say
+  };
+
+  //A data chunk still being written (or streamed) has no usable size;
+  //readers take it to extend to the end of the file.
+  constexpr uint64_t WAV_DATA_SIZE_UNKNOWN = UINT64_MAX;
+
+  //Walks the RIFF or RF64 chunk list in bytes[0, size) up to the start of
+  //the data chunk. Only the header region needs to be present, so this
+  //also works on the first block of a file read some other way. Returns 0,
+  //or a negative error code if the header is malformed, unsupported or
+  //runs past size.
+  int parse_wav_header(const uint8_t* bytes, size_t size, WavLayout& layout);
+
+  //Read-only memory map of a WAV file. The data chunk is exposed in place
+  //as a frame view, so playback reads straight from the page cache without
+  //copies. Call release() behind the play position to keep resident memory
+  //constant on long files.
+  class WavFile
+  {
+    public:
+      WavFile();
+      WavFile(const WavFile&) = delete;
+      WavFile& operator=(const WavFile&) = delete;
+      ~WavFile();
+
+      int open(const std::string& path);
+      void close();
+      bool is_open() const;
+
+      const WavFormat& format() const;
+      uint64_t frames() const;
+      const uint8_t* frame_data(uint64_t first_frame = 0) const;
+
+      //Typed view of the frames from first_frame on. Returns nullptr if
+      //SAMPLE_TYPE doesn't match the file's sample format, or if the data
+      //chunk isn't aligned for SAMPLE_TYPE - RIFF only pads chunks to two
+      //bytes - in which case copy the frames out of frame_data instead.
+      template <typename SAMPLE_TYPE>
+        const SAMPLE_TYPE* frame_view(uint64_t first_frame = 0) const;
+
+      //Drops the pages holding frames before up_to_frame from this
+      //process's resident set. They are re-read from disk if touched again.
+      void release(uint64_t up_to_frame);
+
+    private:
+      int fd;
+      uint8_t* mapping;
+      size_t mapping_size;
+      WavLayout layout;
+      uint64_t frame_count;
+      uint64_t released_bytes;
+  };
+
+  template <typename SAMPLE_TYPE>
+    const SAMPLE_TYPE* WavFile::frame_view(uint64_t first_frame) const
+  {
+    if (mapping == nullptr || sample_format<SAMPLE_TYPE>() != layout.format.pcm_format)
+      return nullptr;
+
+    const uint8_t* frames = frame_data(first_frame);
+
+    if (reinterpret_cast<uintptr_t>(frames) % alignof(SAMPLE_TYPE) != 0)
+      return nullptr;
+
+    return reinterpret_cast<const SAMPLE_TYPE*>(frames);
+  }
+}
+
+#endif
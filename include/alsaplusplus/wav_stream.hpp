@@ -0,0 +1,58 @@
+#ifndef ALSAPLUSPLUS_WAV_STREAM_HPP
+#define ALSAPLUSPLUS_WAV_STREAM_HPP
+
+#include <alsaplusplus/common.hpp>
+#include <alsaplusplus/ring_buffer.hpp>
+#include <alsaplusplus/wav_file.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace AlsaPlusPlus
+{
+  //Streams a WAV file's frames into a FrameRingBuffer from a worker thread,
+  //for storage where mapping the file would stall the audio thread on page
+  //faults (network filesystems, spinning disks). The ring is the read-ahead:
+  //the worker keeps it as full as it can and asks the kernel to prefetch
+  //one ring's worth beyond that, so a slow read eats into buffered audio
+  //instead of reaching PCMPlayer::play_from_ring.
+  class WavStreamSource
+  {
+    public:
+      WavStreamSource();
+      WavStreamSource(const WavStreamSource&) = delete;
+      WavStreamSource& operator=(const WavStreamSource&) = delete;
+      ~WavStreamSource();
+
+      int open(const std::string& path);
+      void close();
+
+      const WavFormat& format() const;
+      uint64_t frames() const;
+
+      //ring must hold whole frames of this file (frame_bytes() ==
+      //block_align) and must not be written by anyone else while running.
+      int start(FrameRingBuffer& ring);
+      void stop();
+
+      //True once every frame has been queued, or reading failed.
+      bool finished() const;
+      int get_error() const; //0, or the negative errno that stopped reading
+
+    private:
+      void read_loop();
+
+      int fd;
+      WavLayout layout;
+      uint64_t frame_count;
+      uint64_t next_frame; //worker thread only
+      FrameRingBuffer* target_ring;
+      std::thread reader_thread;
+      std::atomic<bool> running;
+      std::atomic<bool> end_of_data;
+      std::atomic<int> read_error;
+  };
+}
+
+#endif
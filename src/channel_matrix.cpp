@@ -0,0 +1,287 @@
+#include <alsaplusplus/channel_matrix.hpp>
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ALSAPLUSPLUS_CHANNEL_MATRIX_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ALSAPLUSPLUS_CHANNEL_MATRIX_NEON
+#endif
+
+using namespace AlsaPlusPlus;
+
+constexpr float MINUS_3DB = 0.70710678f;
+
+namespace
+{
+  enum Speaker
+  {
+    FRONT_LEFT,
+    FRONT_RIGHT,
+    REAR_LEFT,
+    REAR_RIGHT,
+    FRONT_CENTER,
+    LFE,
+    MONO
+  };
+
+  //Speaker order per AudioChannels layout, matching ALSA's surround21,
+  //surround40, surround50 and surround51 devices.
+  std::vector<Speaker> layout_speakers(AudioChannels layout)
+  {
+    switch (layout)
+    {
+      case AudioChannels::MONO:
+        return {MONO};
+      case AudioChannels::STEREO:
+        return {FRONT_LEFT, FRONT_RIGHT};
+      case AudioChannels::STEREO_PLUS_SUB:
+        return {FRONT_LEFT, FRONT_RIGHT, LFE};
+      case AudioChannels::STEREO_SURROUND:
+        return {FRONT_LEFT, FRONT_RIGHT, REAR_LEFT, REAR_RIGHT};
+      case AudioChannels::FULL_SURROUND:
+        return {FRONT_LEFT, FRONT_RIGHT, REAR_LEFT, REAR_RIGHT, FRONT_CENTER};
+      case AudioChannels::FULL_SURROUND_PLUS_SUB:
+        return {FRONT_LEFT, FRONT_RIGHT, REAR_LEFT, REAR_RIGHT, FRONT_CENTER, LFE};
+      default:
+        return {};
+    }
+  }
+
+  int find_speaker(const std::vector<Speaker>& speakers, Speaker speaker)
+  {
+    for (size_t i = 0; i < speakers.size(); i++)
+    {
+      if (speakers[i] == speaker)
+        return static_cast<int>(i);
+    }
+
+    return -1;
+  }
+}
+
+ChannelMatrix::ChannelMatrix() :
+  inputs(0),
+  outputs(0)
+{
+}
+
+ChannelMatrix::ChannelMatrix(unsigned int input_channels, unsigned int output_channels) :
+  inputs(input_channels),
+  outputs(output_channels)
+{
+  if (inputs == 0 || outputs == 0 || inputs > MAX_CHANNELS || outputs > MAX_CHANNELS)
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), true, "Channel matrix supports 1 to 8 input and output channels.");
+
+  gains.assign(outputs * inputs, 0.0f);
+  columns.assign(inputs * MAX_CHANNELS, 0.0f);
+}
+
+ChannelMatrix ChannelMatrix::preset(AudioChannels input, AudioChannels output)
+{
+  unsigned int in_count = static_cast<unsigned int>(input);
+  unsigned int out_count = static_cast<unsigned int>(output);
+  ChannelMatrix matrix(in_count, out_count);
+  std::vector<Speaker> in_speakers = layout_speakers(input);
+  std::vector<Speaker> out_speakers = layout_speakers(output);
+
+  if (in_speakers.empty() || out_speakers.empty())
+  {
+    for (unsigned int channel = 0; channel < in_count && channel < out_count; channel++)
+      matrix.set_gain(channel, channel, 1.0f);
+
+    return matrix;
+  }
+
+  bool out_mono = (out_speakers[0] == MONO);
+
+  for (unsigned int in_channel = 0; in_channel < in_count; in_channel++)
+  {
+    Speaker speaker = in_speakers[in_channel];
+    int direct = find_speaker(out_speakers, speaker);
+
+    if (direct >= 0)
+    {
+      matrix.set_gain(direct, in_channel, 1.0f);
+      continue;
+    }
+
+    if (out_mono)
+    {
+      if (speaker != LFE)
+        matrix.set_gain(0, in_channel, 1.0f);
+
+      continue;
+    }
+
+    int left = find_speaker(out_speakers, FRONT_LEFT);
+    int right = find_speaker(out_speakers, FRONT_RIGHT);
+
+    switch (speaker)
+    {
+      case MONO:
+        matrix.set_gain(left, in_channel, 1.0f);
+        matrix.set_gain(right, in_channel, 1.0f);
+        break;
+      case FRONT_CENTER:
+        matrix.set_gain(left, in_channel, MINUS_3DB);
+        matrix.set_gain(right, in_channel, MINUS_3DB);
+        break;
+      case REAR_LEFT:
+        matrix.set_gain(left, in_channel, MINUS_3DB);
+        break;
+      case REAR_RIGHT:
+        matrix.set_gain(right, in_channel, MINUS_3DB);
+        break;
+      default:
+        break; //LFE without a subwoofer output
+    }
+  }
+
+  //A row summing past 1.0 could clip when all its inputs peak together.
+  for (unsigned int out_channel = 0; out_channel < out_count; out_channel++)
+  {
+    float sum = 0.0f;
+
+    for (unsigned int in_channel = 0; in_channel < in_count; in_channel++)
+      sum += matrix.get_gain(out_channel, in_channel);
+
+    if (sum > 1.0f)
+    {
+      for (unsigned int in_channel = 0; in_channel < in_count; in_channel++)
+        matrix.set_gain(out_channel, in_channel, matrix.get_gain(out_channel, in_channel) / sum);
+    }
+  }
+
+  return matrix;
+}
+
+void ChannelMatrix::set_gain(unsigned int output_channel, unsigned int input_channel, float gain)
+{
+  if (output_channel >= outputs || input_channel >= inputs)
+    return;
+
+  gains[output_channel * inputs + input_channel] = gain;
+  update_columns();
+}
+
+float ChannelMatrix::get_gain(unsigned int output_channel, unsigned int input_channel) const
+{
+  if (output_channel >= outputs || input_channel >= inputs)
+    return 0.0f;
+
+  return gains[output_channel * inputs + input_channel];
+}
+
+unsigned int ChannelMatrix::input_channels() const
+{
+  return inputs;
+}
+
+unsigned int ChannelMatrix::output_channels() const
+{
+  return outputs;
+}
+
+bool ChannelMatrix::is_identity() const
+{
+  if (inputs != outputs)
+    return false;
+
+  for (unsigned int out_channel = 0; out_channel < outputs; out_channel++)
+  {
+    for (unsigned int in_channel = 0; in_channel < inputs; in_channel++)
+    {
+      if (gains[out_channel * inputs + in_channel] != ((out_channel == in_channel) ? 1.0f : 0.0f))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+//The kernels accumulate one whole output frame at a time: each input sample
+//is broadcast and multiplied into its column of gains.
+void ChannelMatrix::update_columns()
+{
+  for (unsigned int in_channel = 0; in_channel < inputs; in_channel++)
+  {
+    for (unsigned int out_channel = 0; out_channel < outputs; out_channel++)
+      columns[in_channel * MAX_CHANNELS + out_channel] = gains[out_channel * inputs + in_channel];
+  }
+}
+
+void ChannelMatrix::apply(const float* input, float* output, size_t frame_count) const
+{
+  if (frame_count == 0 || inputs == 0)
+    return;
+
+  size_t frame = 0;
+
+#if defined(ALSAPLUSPLUS_CHANNEL_MATRIX_X86) || defined(ALSAPLUSPLUS_CHANNEL_MATRIX_NEON)
+  //Vector stores write whole blocks of four outputs. When outputs isn't a
+  //multiple of four the spill lands on the following frames, which are
+  //overwritten on later iterations - so only the frames whose spill would
+  //run past the buffer take the scalar path.
+  bool two_blocks = (outputs > 4);
+  size_t store_width = two_blocks ? 8 : 4;
+  size_t total_samples = frame_count * outputs;
+  size_t vector_frames = (total_samples >= store_width) ? (total_samples - store_width) / outputs + 1 : 0;
+
+  for (; frame < vector_frames; frame++)
+  {
+    const float* in_frame = input + frame * inputs;
+    float* out_frame = output + frame * outputs;
+    const float* column = columns.data();
+
+#if defined(ALSAPLUSPLUS_CHANNEL_MATRIX_X86)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+
+    for (unsigned int in_channel = 0; in_channel < inputs; in_channel++, column += MAX_CHANNELS)
+    {
+      __m128 sample = _mm_set1_ps(in_frame[in_channel]);
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(sample, _mm_loadu_ps(column)));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(sample, _mm_loadu_ps(column + 4)));
+    }
+
+    _mm_storeu_ps(out_frame, acc0);
+
+    if (two_blocks)
+      _mm_storeu_ps(out_frame + 4, acc1);
+#else
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+    for (unsigned int in_channel = 0; in_channel < inputs; in_channel++, column += MAX_CHANNELS)
+    {
+      acc0 = vmlaq_n_f32(acc0, vld1q_f32(column), in_frame[in_channel]);
+      acc1 = vmlaq_n_f32(acc1, vld1q_f32(column + 4), in_frame[in_channel]);
+    }
+
+    vst1q_f32(out_frame, acc0);
+
+    if (two_blocks)
+      vst1q_f32(out_frame + 4, acc1);
+#endif
+  }
+#endif
+
+  for (; frame < frame_count; frame++)
+  {
+    const float* in_frame = input + frame * inputs;
+    float* out_frame = output + frame * outputs;
+
+    for (unsigned int out_channel = 0; out_channel < outputs; out_channel++)
+    {
+      float sum = 0.0f;
+
+      for (unsigned int in_channel = 0; in_channel < inputs; in_channel++)
+        sum += columns[in_channel * MAX_CHANNELS + out_channel] * in_frame[in_channel];
+
+      out_frame[out_channel] = sum;
+    }
+  }
+}
@@ -0,0 +1,689 @@
+#include <alsaplusplus/convert.hpp>
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ALSAPLUSPLUS_CONVERT_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ALSAPLUSPLUS_CONVERT_NEON
+#endif
+
+using namespace AlsaPlusPlus;
+
+//Full-scale factors and clip limits per integer width. The S32 upper limit
+//is the largest float below 2^31, so the float-to-int conversion can't wrap.
+constexpr float U8_SCALE = 128.0f;
+constexpr float S16_SCALE = 32768.0f;
+constexpr float S24_SCALE = 8388608.0f;
+constexpr float S24_MAX = 8388607.0f;
+constexpr float S32_SCALE = 2147483648.0f;
+constexpr float S32_MAX = 2147483520.0f;
+
+namespace
+{
+  typedef void (*FloatToInt32Kernel)(const float* src, int32_t* dst, size_t samples, float scale, float max_value, DitherState* dither);
+  typedef void (*FloatToS16Kernel)(const float* src, int16_t* dst, size_t samples, DitherState* dither);
+  typedef void (*FloatToU8Kernel)(const float* src, uint8_t* dst, size_t samples, DitherState* dither);
+  typedef void (*Int32ToFloatKernel)(const int32_t* src, float* dst, size_t samples, int container_shift, float scale);
+  typedef void (*S16ToFloatKernel)(const int16_t* src, float* dst, size_t samples);
+
+  //One complete set of kernels; picked once per process by active_kernels().
+  struct ConversionKernels
+  {
+    const char* name;
+    FloatToInt32Kernel float_to_int32;
+    FloatToS16Kernel float_to_s16;
+    FloatToU8Kernel float_to_u8;
+    Int32ToFloatKernel int32_to_float;
+    S16ToFloatKernel s16_to_float;
+  };
+
+  inline uint32_t xorshift32(uint32_t& state)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  //Uniform in [0, 1) built from the top 23 random bits as a mantissa.
+  inline float uniform(uint32_t& state)
+  {
+    uint32_t bits = (xorshift32(state) >> 9) | 0x3F800000u;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value - 1.0f;
+  }
+
+  //Triangular noise in (-1, 1) LSB - the sum of two uniform variables.
+  inline float tpdf(DitherState* dither)
+  {
+    if (dither == nullptr)
+      return 0.0f;
+
+    return uniform(dither->lanes[0]) - uniform(dither->lanes[0]);
+  }
+
+  inline int32_t clip_round(float value, float min_value, float max_value)
+  {
+    value = (value < min_value) ? min_value : value;
+    value = (value > max_value) ? max_value : value;
+    return static_cast<int32_t>(lrintf(value));
+  }
+
+  //Scalar reference kernels. The SIMD variants fall back to these for the
+  //tail that doesn't fill a whole vector.
+  void float_to_int32_scalar(const float* src, int32_t* dst, size_t samples, float scale, float max_value, DitherState* dither)
+  {
+    for (size_t i = 0; i < samples; i++)
+      dst[i] = clip_round((src[i] * scale) + tpdf(dither), -scale, max_value);
+  }
+
+  void float_to_s16_scalar(const float* src, int16_t* dst, size_t samples, DitherState* dither)
+  {
+    for (size_t i = 0; i < samples; i++)
+      dst[i] = static_cast<int16_t>(clip_round((src[i] * S16_SCALE) + tpdf(dither), -S16_SCALE, S16_SCALE - 1.0f));
+  }
+
+  void float_to_u8_scalar(const float* src, uint8_t* dst, size_t samples, DitherState* dither)
+  {
+    for (size_t i = 0; i < samples; i++)
+      dst[i] = static_cast<uint8_t>(clip_round((src[i] * U8_SCALE) + tpdf(dither), -U8_SCALE, U8_SCALE - 1.0f) + 128);
+  }
+
+  void int32_to_float_scalar(const int32_t* src, float* dst, size_t samples, int container_shift, float scale)
+  {
+    //Shift up then arithmetic-shift back to sign-extend 24-bit containers.
+    for (size_t i = 0; i < samples; i++)
+      dst[i] = static_cast<float>(static_cast<int32_t>(static_cast<uint32_t>(src[i]) << container_shift) >> container_shift) / scale;
+  }
+
+  void s16_to_float_scalar(const int16_t* src, float* dst, size_t samples)
+  {
+    for (size_t i = 0; i < samples; i++)
+      dst[i] = static_cast<float>(src[i]) / S16_SCALE;
+  }
+
+  //Packed 24-bit (both directions) and unsigned 8-bit capture are rare
+  //enough that they stay scalar on every backend.
+  void float_to_s24_3le(const float* src, uint8_t* dst, size_t samples, DitherState* dither)
+  {
+    for (size_t i = 0; i < samples; i++)
+    {
+      int32_t value = clip_round((src[i] * S24_SCALE) + tpdf(dither), -S24_SCALE, S24_MAX);
+      dst[(i * 3)] = static_cast<uint8_t>(value);
+      dst[(i * 3) + 1] = static_cast<uint8_t>(value >> 8);
+      dst[(i * 3) + 2] = static_cast<uint8_t>(value >> 16);
+    }
+  }
+
+  void s24_3le_to_float(const uint8_t* src, float* dst, size_t samples)
+  {
+    for (size_t i = 0; i < samples; i++)
+    {
+      uint32_t packed = src[(i * 3)] | (src[(i * 3) + 1] << 8) | (static_cast<uint32_t>(src[(i * 3) + 2]) << 16);
+      dst[i] = static_cast<float>(static_cast<int32_t>(packed << 8) >> 8) / S24_SCALE;
+    }
+  }
+
+  //Float hardware takes the samples as they are apart from clipping, which
+  //the compiler vectorizes on its own.
+  void float_clip(const float* src, float* dst, size_t samples)
+  {
+    for (size_t i = 0; i < samples; i++)
+    {
+      float value = src[i];
+      value = (value < -1.0f) ? -1.0f : value;
+      dst[i] = (value > 1.0f) ? 1.0f : value;
+    }
+  }
+
+  void u8_to_float(const uint8_t* src, float* dst, size_t samples)
+  {
+    for (size_t i = 0; i < samples; i++)
+      dst[i] = (static_cast<float>(src[i]) - 128.0f) / U8_SCALE;
+  }
+
+  const ConversionKernels SCALAR_KERNELS =
+  {
+    "scalar",
+    float_to_int32_scalar,
+    float_to_s16_scalar,
+    float_to_u8_scalar,
+    int32_to_float_scalar,
+    s16_to_float_scalar
+  };
+
+#ifdef ALSAPLUSPLUS_CONVERT_X86
+  //SSE2 - baseline on x86_64.
+  __attribute__((target("sse2"))) inline __m128 tpdf_sse2(__m128i& state)
+  {
+    const __m128i one_bits = _mm_set1_epi32(0x3F800000);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 noise[2];
+
+    for (int n = 0; n < 2; n++)
+    {
+      state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+      state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+      state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+      noise[n] = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state, 9), one_bits)), one);
+    }
+
+    return _mm_sub_ps(noise[0], noise[1]);
+  }
+
+  //Scales, dithers and clips four floats, leaving them ready to convert.
+  __attribute__((target("sse2"))) inline __m128 scale_sse2(const float* src, __m128 scale, __m128 min_value, __m128 max_value, __m128i& state, bool dither)
+  {
+    __m128 value = _mm_mul_ps(_mm_loadu_ps(src), scale);
+
+    if (dither)
+      value = _mm_add_ps(value, tpdf_sse2(state));
+
+    return _mm_min_ps(_mm_max_ps(value, min_value), max_value);
+  }
+
+  __attribute__((target("sse2"))) void float_to_int32_sse2(const float* src, int32_t* dst, size_t samples, float scale, float max_value, DitherState* dither)
+  {
+    const __m128 v_scale = _mm_set1_ps(scale);
+    const __m128 v_min = _mm_set1_ps(-scale);
+    const __m128 v_max = _mm_set1_ps(max_value);
+    __m128i state = (dither != nullptr) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->lanes)) : _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_cvtps_epi32(scale_sse2(src + i, v_scale, v_min, v_max, state, dither != nullptr)));
+
+    if (dither != nullptr)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->lanes), state);
+
+    float_to_int32_scalar(src + i, dst + i, samples - i, scale, max_value, dither);
+  }
+
+  __attribute__((target("sse2"))) void float_to_s16_sse2(const float* src, int16_t* dst, size_t samples, DitherState* dither)
+  {
+    const __m128 v_scale = _mm_set1_ps(S16_SCALE);
+    const __m128 v_min = _mm_set1_ps(-S16_SCALE);
+    const __m128 v_max = _mm_set1_ps(S16_SCALE - 1.0f);
+    __m128i state = (dither != nullptr) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->lanes)) : _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m128i low = _mm_cvtps_epi32(scale_sse2(src + i, v_scale, v_min, v_max, state, dither != nullptr));
+      __m128i high = _mm_cvtps_epi32(scale_sse2(src + i + 4, v_scale, v_min, v_max, state, dither != nullptr));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(low, high));
+    }
+
+    if (dither != nullptr)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->lanes), state);
+
+    float_to_s16_scalar(src + i, dst + i, samples - i, dither);
+  }
+
+  __attribute__((target("sse2"))) void float_to_u8_sse2(const float* src, uint8_t* dst, size_t samples, DitherState* dither)
+  {
+    const __m128 v_scale = _mm_set1_ps(U8_SCALE);
+    const __m128 v_min = _mm_set1_ps(-U8_SCALE);
+    const __m128 v_max = _mm_set1_ps(U8_SCALE - 1.0f);
+    const __m128i offset = _mm_set1_epi16(128);
+    __m128i state = (dither != nullptr) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->lanes)) : _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m128i low = _mm_cvtps_epi32(scale_sse2(src + i, v_scale, v_min, v_max, state, dither != nullptr));
+      __m128i high = _mm_cvtps_epi32(scale_sse2(src + i + 4, v_scale, v_min, v_max, state, dither != nullptr));
+      __m128i words = _mm_add_epi16(_mm_packs_epi32(low, high), offset);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words));
+    }
+
+    if (dither != nullptr)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->lanes), state);
+
+    float_to_u8_scalar(src + i, dst + i, samples - i, dither);
+  }
+
+  __attribute__((target("sse2"))) void int32_to_float_sse2(const int32_t* src, float* dst, size_t samples, int container_shift, float scale)
+  {
+    const __m128 v_scale = _mm_set1_ps(1.0f / scale);
+    const __m128i shift = _mm_cvtsi32_si128(container_shift);
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4)
+    {
+      __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      value = _mm_sra_epi32(_mm_sll_epi32(value, shift), shift);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(value), v_scale));
+    }
+
+    int32_to_float_scalar(src + i, dst + i, samples - i, container_shift, scale);
+  }
+
+  __attribute__((target("sse2"))) void s16_to_float_sse2(const int16_t* src, float* dst, size_t samples)
+  {
+    const __m128 v_scale = _mm_set1_ps(1.0f / S16_SCALE);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+      __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(low), v_scale));
+      _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), v_scale));
+    }
+
+    s16_to_float_scalar(src + i, dst + i, samples - i);
+  }
+
+  const ConversionKernels SSE2_KERNELS =
+  {
+    "sse2",
+    float_to_int32_sse2,
+    float_to_s16_sse2,
+    float_to_u8_sse2,
+    int32_to_float_sse2,
+    s16_to_float_sse2
+  };
+
+  //AVX2 - selected at runtime when the CPU reports it.
+  __attribute__((target("avx2"))) inline __m256 tpdf_avx2(__m256i& state)
+  {
+    const __m256i one_bits = _mm256_set1_epi32(0x3F800000);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 noise[2];
+
+    for (int n = 0; n < 2; n++)
+    {
+      state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+      state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+      state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+      noise[n] = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_srli_epi32(state, 9), one_bits)), one);
+    }
+
+    return _mm256_sub_ps(noise[0], noise[1]);
+  }
+
+  __attribute__((target("avx2"))) inline __m256 scale_avx2(const float* src, __m256 scale, __m256 min_value, __m256 max_value, __m256i& state, bool dither)
+  {
+    __m256 value = _mm256_mul_ps(_mm256_loadu_ps(src), scale);
+
+    if (dither)
+      value = _mm256_add_ps(value, tpdf_avx2(state));
+
+    return _mm256_min_ps(_mm256_max_ps(value, min_value), max_value);
+  }
+
+  __attribute__((target("avx2"))) void float_to_int32_avx2(const float* src, int32_t* dst, size_t samples, float scale, float max_value, DitherState* dither)
+  {
+    const __m256 v_scale = _mm256_set1_ps(scale);
+    const __m256 v_min = _mm256_set1_ps(-scale);
+    const __m256 v_max = _mm256_set1_ps(max_value);
+    __m256i state = (dither != nullptr) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dither->lanes)) : _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtps_epi32(scale_avx2(src + i, v_scale, v_min, v_max, state, dither != nullptr)));
+
+    if (dither != nullptr)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dither->lanes), state);
+
+    float_to_int32_scalar(src + i, dst + i, samples - i, scale, max_value, dither);
+  }
+
+  __attribute__((target("avx2"))) void float_to_s16_avx2(const float* src, int16_t* dst, size_t samples, DitherState* dither)
+  {
+    const __m256 v_scale = _mm256_set1_ps(S16_SCALE);
+    const __m256 v_min = _mm256_set1_ps(-S16_SCALE);
+    const __m256 v_max = _mm256_set1_ps(S16_SCALE - 1.0f);
+    __m256i state = (dither != nullptr) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dither->lanes)) : _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16)
+    {
+      __m256i low = _mm256_cvtps_epi32(scale_avx2(src + i, v_scale, v_min, v_max, state, dither != nullptr));
+      __m256i high = _mm256_cvtps_epi32(scale_avx2(src + i + 8, v_scale, v_min, v_max, state, dither != nullptr));
+
+      //packs works per 128-bit lane; restore sample order afterwards.
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+
+    if (dither != nullptr)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dither->lanes), state);
+
+    float_to_s16_scalar(src + i, dst + i, samples - i, dither);
+  }
+
+  __attribute__((target("avx2"))) void int32_to_float_avx2(const int32_t* src, float* dst, size_t samples, int container_shift, float scale)
+  {
+    const __m256 v_scale = _mm256_set1_ps(1.0f / scale);
+    const __m128i shift = _mm_cvtsi32_si128(container_shift);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      value = _mm256_sra_epi32(_mm256_sll_epi32(value, shift), shift);
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(value), v_scale));
+    }
+
+    int32_to_float_scalar(src + i, dst + i, samples - i, container_shift, scale);
+  }
+
+  __attribute__((target("avx2"))) void s16_to_float_avx2(const int16_t* src, float* dst, size_t samples)
+  {
+    const __m256 v_scale = _mm256_set1_ps(1.0f / S16_SCALE);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m256i value = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(value), v_scale));
+    }
+
+    s16_to_float_scalar(src + i, dst + i, samples - i);
+  }
+
+  const ConversionKernels AVX2_KERNELS =
+  {
+    "avx2",
+    float_to_int32_avx2,
+    float_to_s16_avx2,
+    float_to_u8_sse2,
+    int32_to_float_avx2,
+    s16_to_float_avx2
+  };
+#endif
+
+#ifdef ALSAPLUSPLUS_CONVERT_NEON
+  inline float32x4_t tpdf_neon(uint32x4_t& state)
+  {
+    const uint32x4_t one_bits = vdupq_n_u32(0x3F800000);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t noise[2];
+
+    for (int n = 0; n < 2; n++)
+    {
+      state = veorq_u32(state, vshlq_n_u32(state, 13));
+      state = veorq_u32(state, vshrq_n_u32(state, 17));
+      state = veorq_u32(state, vshlq_n_u32(state, 5));
+      noise[n] = vsubq_f32(vreinterpretq_f32_u32(vorrq_u32(vshrq_n_u32(state, 9), one_bits)), one);
+    }
+
+    return vsubq_f32(noise[0], noise[1]);
+  }
+
+  inline int32x4_t scale_round_neon(const float* src, float32x4_t scale, float32x4_t min_value, float32x4_t max_value, uint32x4_t& state, bool dither)
+  {
+    float32x4_t value = vmulq_f32(vld1q_f32(src), scale);
+
+    if (dither)
+      value = vaddq_f32(value, tpdf_neon(state));
+
+    return vcvtnq_s32_f32(vminq_f32(vmaxq_f32(value, min_value), max_value));
+  }
+
+  void float_to_int32_neon(const float* src, int32_t* dst, size_t samples, float scale, float max_value, DitherState* dither)
+  {
+    const float32x4_t v_scale = vdupq_n_f32(scale);
+    const float32x4_t v_min = vdupq_n_f32(-scale);
+    const float32x4_t v_max = vdupq_n_f32(max_value);
+    uint32x4_t state = (dither != nullptr) ? vld1q_u32(dither->lanes) : vdupq_n_u32(0);
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4)
+      vst1q_s32(dst + i, scale_round_neon(src + i, v_scale, v_min, v_max, state, dither != nullptr));
+
+    if (dither != nullptr)
+      vst1q_u32(dither->lanes, state);
+
+    float_to_int32_scalar(src + i, dst + i, samples - i, scale, max_value, dither);
+  }
+
+  void float_to_s16_neon(const float* src, int16_t* dst, size_t samples, DitherState* dither)
+  {
+    const float32x4_t v_scale = vdupq_n_f32(S16_SCALE);
+    const float32x4_t v_min = vdupq_n_f32(-S16_SCALE);
+    const float32x4_t v_max = vdupq_n_f32(S16_SCALE - 1.0f);
+    uint32x4_t state = (dither != nullptr) ? vld1q_u32(dither->lanes) : vdupq_n_u32(0);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      int32x4_t low = scale_round_neon(src + i, v_scale, v_min, v_max, state, dither != nullptr);
+      int32x4_t high = scale_round_neon(src + i + 4, v_scale, v_min, v_max, state, dither != nullptr);
+      vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+
+    if (dither != nullptr)
+      vst1q_u32(dither->lanes, state);
+
+    float_to_s16_scalar(src + i, dst + i, samples - i, dither);
+  }
+
+  void int32_to_float_neon(const int32_t* src, float* dst, size_t samples, int container_shift, float scale)
+  {
+    const float32x4_t v_scale = vdupq_n_f32(1.0f / scale);
+    const int32x4_t shift_up = vdupq_n_s32(container_shift);
+    const int32x4_t shift_down = vdupq_n_s32(-container_shift);
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4)
+    {
+      int32x4_t value = vshlq_s32(vshlq_s32(vld1q_s32(src + i), shift_up), shift_down);
+      vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(value), v_scale));
+    }
+
+    int32_to_float_scalar(src + i, dst + i, samples - i, container_shift, scale);
+  }
+
+  void s16_to_float_neon(const int16_t* src, float* dst, size_t samples)
+  {
+    const float32x4_t v_scale = vdupq_n_f32(1.0f / S16_SCALE);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8)
+    {
+      int16x8_t words = vld1q_s16(src + i);
+      vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(words))), v_scale));
+      vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(words))), v_scale));
+    }
+
+    s16_to_float_scalar(src + i, dst + i, samples - i);
+  }
+
+  const ConversionKernels NEON_KERNELS =
+  {
+    "neon",
+    float_to_int32_neon,
+    float_to_s16_neon,
+    float_to_u8_scalar,
+    int32_to_float_neon,
+    s16_to_float_neon
+  };
+#endif
+
+  const ConversionKernels& select_kernels()
+  {
+#ifdef ALSAPLUSPLUS_CONVERT_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+      return AVX2_KERNELS;
+
+    if (__builtin_cpu_supports("sse2"))
+      return SSE2_KERNELS;
+#endif
+#ifdef ALSAPLUSPLUS_CONVERT_NEON
+    return NEON_KERNELS;
+#endif
+
+    return SCALAR_KERNELS;
+  }
+
+  const ConversionKernels& active_kernels()
+  {
+    static const ConversionKernels& kernels = select_kernels();
+    return kernels;
+  }
+}
+
+DitherState::DitherState(uint32_t seed)
+{
+  //xorshift32 must never be seeded with zero.
+  for (int lane = 0; lane < 8; lane++)
+  {
+    lanes[lane] = seed ^ (0x85EBCA6Bu * static_cast<uint32_t>(lane + 1));
+
+    if (lanes[lane] == 0)
+      lanes[lane] = 0x9E3779B9u;
+  }
+}
+
+const char* AlsaPlusPlus::conversion_backend()
+{
+  return active_kernels().name;
+}
+
+bool AlsaPlusPlus::conversion_supported(snd_pcm_format_t format)
+{
+  switch (format)
+  {
+    case SND_PCM_FORMAT_U8:
+    case SND_PCM_FORMAT_S16_LE:
+    case SND_PCM_FORMAT_S24_LE:
+    case SND_PCM_FORMAT_S24_3LE:
+    case SND_PCM_FORMAT_S32_LE:
+    case SND_PCM_FORMAT_FLOAT_LE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void AlsaPlusPlus::convert_from_float(const float* src, uint8_t* dst, size_t samples, DitherState* dither)
+{
+  active_kernels().float_to_u8(src, dst, samples, dither);
+}
+
+void AlsaPlusPlus::convert_from_float(const float* src, int16_t* dst, size_t samples, DitherState* dither)
+{
+  active_kernels().float_to_s16(src, dst, samples, dither);
+}
+
+void AlsaPlusPlus::convert_from_float(const float* src, S24Sample* dst, size_t samples, DitherState* dither)
+{
+  active_kernels().float_to_int32(src, reinterpret_cast<int32_t*>(dst), samples, S24_SCALE, S24_MAX, dither);
+}
+
+void AlsaPlusPlus::convert_from_float(const float* src, S24PackedSample* dst, size_t samples, DitherState* dither)
+{
+  float_to_s24_3le(src, reinterpret_cast<uint8_t*>(dst), samples, dither);
+}
+
+void AlsaPlusPlus::convert_from_float(const float* src, int32_t* dst, size_t samples, DitherState*)
+{
+  //Dither is far below the noise floor at 32 bits.
+  active_kernels().float_to_int32(src, dst, samples, S32_SCALE, S32_MAX, nullptr);
+}
+
+void AlsaPlusPlus::convert_from_float(const float* src, float* dst, size_t samples, DitherState*)
+{
+  float_clip(src, dst, samples);
+}
+
+void AlsaPlusPlus::convert_to_float(const uint8_t* src, float* dst, size_t samples)
+{
+  u8_to_float(src, dst, samples);
+}
+
+void AlsaPlusPlus::convert_to_float(const int16_t* src, float* dst, size_t samples)
+{
+  active_kernels().s16_to_float(src, dst, samples);
+}
+
+void AlsaPlusPlus::convert_to_float(const S24Sample* src, float* dst, size_t samples)
+{
+  active_kernels().int32_to_float(reinterpret_cast<const int32_t*>(src), dst, samples, 8, S24_SCALE);
+}
+
+void AlsaPlusPlus::convert_to_float(const S24PackedSample* src, float* dst, size_t samples)
+{
+  s24_3le_to_float(reinterpret_cast<const uint8_t*>(src), dst, samples);
+}
+
+void AlsaPlusPlus::convert_to_float(const int32_t* src, float* dst, size_t samples)
+{
+  active_kernels().int32_to_float(src, dst, samples, 0, S32_SCALE);
+}
+
+void AlsaPlusPlus::convert_to_float(const float* src, float* dst, size_t samples)
+{
+  if (dst != src)
+    memcpy(dst, src, samples * sizeof(float));
+}
+
+int AlsaPlusPlus::convert_from_float(const float* src, void* dst, snd_pcm_format_t format, size_t samples, DitherState* dither)
+{
+  switch (format)
+  {
+    case SND_PCM_FORMAT_U8:
+      convert_from_float(src, static_cast<uint8_t*>(dst), samples, dither);
+      break;
+    case SND_PCM_FORMAT_S16_LE:
+      convert_from_float(src, static_cast<int16_t*>(dst), samples, dither);
+      break;
+    case SND_PCM_FORMAT_S24_LE:
+      convert_from_float(src, static_cast<S24Sample*>(dst), samples, dither);
+      break;
+    case SND_PCM_FORMAT_S24_3LE:
+      convert_from_float(src, static_cast<S24PackedSample*>(dst), samples, dither);
+      break;
+    case SND_PCM_FORMAT_S32_LE:
+      convert_from_float(src, static_cast<int32_t*>(dst), samples, dither);
+      break;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      convert_from_float(src, static_cast<float*>(dst), samples, dither);
+      break;
+    default:
+      handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "No conversion from float to the requested sample format.");
+      return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  return 0;
+}
+
+int AlsaPlusPlus::convert_to_float(const void* src, float* dst, snd_pcm_format_t format, size_t samples)
+{
+  switch (format)
+  {
+    case SND_PCM_FORMAT_U8:
+      convert_to_float(static_cast<const uint8_t*>(src), dst, samples);
+      break;
+    case SND_PCM_FORMAT_S16_LE:
+      convert_to_float(static_cast<const int16_t*>(src), dst, samples);
+      break;
+    case SND_PCM_FORMAT_S24_LE:
+      convert_to_float(static_cast<const S24Sample*>(src), dst, samples);
+      break;
+    case SND_PCM_FORMAT_S24_3LE:
+      convert_to_float(static_cast<const S24PackedSample*>(src), dst, samples);
+      break;
+    case SND_PCM_FORMAT_S32_LE:
+      convert_to_float(static_cast<const int32_t*>(src), dst, samples);
+      break;
+    case SND_PCM_FORMAT_FLOAT_LE:
+      convert_to_float(static_cast<const float*>(src), dst, samples);
+      break;
+    default:
+      handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "No conversion from the requested sample format to float.");
+      return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  return 0;
+}
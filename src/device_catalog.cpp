@@ -0,0 +1,638 @@
+#include <alsaplusplus/device_catalog.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+using namespace AlsaPlusPlus;
+
+constexpr const char* CACHE_HEADER = "alsaplusplus-device-cache 1";
+
+//Rates worth listing individually; the full range is kept as well.
+static const unsigned int COMMON_RATES[] = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 64000, 88200, 96000, 176400, 192000, 352800, 384000 };
+
+namespace
+{
+  struct ProbeJob
+  {
+    CardProfile* card;
+    PCMEndpoint* endpoint; //nullptr probes the card's mixer
+    snd_pcm_stream_t stream_type;
+    int result;
+  };
+
+  //"hw:CARD=PCH,DEV=0" -> "PCH"
+  std::string card_id_of(const std::string& name)
+  {
+    size_t start = name.find("CARD=");
+
+    if (start == std::string::npos)
+      return std::string();
+
+    start += 5;
+    size_t end = name.find(',', start);
+
+    return name.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+  }
+
+  int probe_endpoint(const std::string& name, snd_pcm_stream_t stream_type, PCMCapabilities& caps)
+  {
+    int err;
+    snd_pcm_t* pcm_handle;
+
+    //Non-blocking so a device held by another process fails at once with
+    //-EBUSY instead of stalling the probe.
+    if ((err = snd_pcm_open(&pcm_handle, name.c_str(), stream_type, SND_PCM_NONBLOCK)) < 0)
+    {
+      if (err != -EBUSY)
+        handle_error_code(err, false, "Cannot open PCM endpoint to probe it.", name.c_str());
+
+      return err;
+    }
+
+    snd_pcm_hw_params_t* hw_params;
+    snd_pcm_hw_params_alloca(&hw_params);
+
+    if ((err = snd_pcm_hw_params_any(pcm_handle, hw_params)) < 0)
+    {
+      handle_error_code(err, false, "Cannot initialize hardware parameter structure for PCM object.", name.c_str());
+      snd_pcm_close(pcm_handle);
+      return err;
+    }
+
+    caps.access_types.clear();
+    caps.formats.clear();
+    caps.rates.clear();
+
+    for (int access = 0; access <= SND_PCM_ACCESS_LAST; access++)
+    {
+      if (snd_pcm_hw_params_test_access(pcm_handle, hw_params, static_cast<snd_pcm_access_t>(access)) == 0)
+        caps.access_types.push_back(static_cast<snd_pcm_access_t>(access));
+    }
+
+    for (int format = 0; format <= SND_PCM_FORMAT_LAST; format++)
+    {
+      if (snd_pcm_hw_params_test_format(pcm_handle, hw_params, static_cast<snd_pcm_format_t>(format)) == 0)
+        caps.formats.push_back(static_cast<snd_pcm_format_t>(format));
+    }
+
+    snd_pcm_hw_params_get_rate_min(hw_params, &caps.rate_min, 0);
+    snd_pcm_hw_params_get_rate_max(hw_params, &caps.rate_max, 0);
+    snd_pcm_hw_params_get_channels_min(hw_params, &caps.channels_min);
+    snd_pcm_hw_params_get_channels_max(hw_params, &caps.channels_max);
+    snd_pcm_hw_params_get_period_size_min(hw_params, &caps.period_size_min, 0);
+    snd_pcm_hw_params_get_period_size_max(hw_params, &caps.period_size_max, 0);
+    snd_pcm_hw_params_get_periods_min(hw_params, &caps.periods_min, 0);
+    snd_pcm_hw_params_get_periods_max(hw_params, &caps.periods_max, 0);
+    snd_pcm_hw_params_get_buffer_size_min(hw_params, &caps.buffer_size_min);
+    snd_pcm_hw_params_get_buffer_size_max(hw_params, &caps.buffer_size_max);
+
+    for (unsigned int rate : COMMON_RATES)
+    {
+      if (rate >= caps.rate_min && rate <= caps.rate_max && snd_pcm_hw_params_test_rate(pcm_handle, hw_params, rate, 0) == 0)
+        caps.rates.push_back(rate);
+    }
+
+    snd_pcm_close(pcm_handle);
+    caps.probed = true;
+
+    return 0;
+  }
+
+  int probe_mixer(const std::string& card_id, std::vector<std::string>& elements)
+  {
+    int err;
+    snd_mixer_t* mixer_handle;
+    std::string device = "hw:CARD=" + card_id;
+
+    if ((err = snd_mixer_open(&mixer_handle, 0)) < 0)
+    {
+      handle_error_code(err, false, "Cannot open handle to a mixer device.", device.c_str());
+      return err;
+    }
+
+    if ((err = snd_mixer_attach(mixer_handle, device.c_str())) < 0 ||
+        (err = snd_mixer_selem_register(mixer_handle, NULL, NULL)) < 0 ||
+        (err = snd_mixer_load(mixer_handle)) < 0)
+    {
+      handle_error_code(err, false, "Cannot load sound mixer.", device.c_str());
+      snd_mixer_close(mixer_handle);
+      return err;
+    }
+
+    elements.clear();
+
+    //Mixer looks elements up at index 0, so only those are usable by name.
+    for (snd_mixer_elem_t* elem = snd_mixer_first_elem(mixer_handle); elem != NULL; elem = snd_mixer_elem_next(elem))
+    {
+      if (snd_mixer_selem_get_index(elem) == 0)
+        elements.push_back(snd_mixer_selem_get_name(elem));
+    }
+
+    snd_mixer_close(mixer_handle);
+    return 0;
+  }
+
+  void write_caps(std::ofstream& out, const char* direction, const PCMCapabilities& caps)
+  {
+    out << "caps " << direction << "\n";
+    out << "access";
+
+    for (snd_pcm_access_t access : caps.access_types)
+      out << " " << static_cast<int>(access);
+
+    out << "\nformats";
+
+    for (snd_pcm_format_t format : caps.formats)
+      out << " " << static_cast<int>(format);
+
+    out << "\nrates";
+
+    for (unsigned int rate : caps.rates)
+      out << " " << rate;
+
+    out << "\nrate_range " << caps.rate_min << " " << caps.rate_max << "\n";
+    out << "channels " << caps.channels_min << " " << caps.channels_max << "\n";
+    out << "period_size " << caps.period_size_min << " " << caps.period_size_max << "\n";
+    out << "periods " << caps.periods_min << " " << caps.periods_max << "\n";
+    out << "buffer_size " << caps.buffer_size_min << " " << caps.buffer_size_max << "\n";
+  }
+
+  //The rest of the line after a keyword and one space.
+  std::string line_value(const std::string& line, const std::string& keyword)
+  {
+    return (line.size() > keyword.size()) ? line.substr(keyword.size() + 1) : std::string();
+  }
+}
+
+DeviceCatalog::DeviceCatalog() :
+  probe_threads(0)
+{
+  start_error_drain();
+}
+
+int DeviceCatalog::scan(std::string cache_path)
+{
+  int err;
+
+  if (!cache_path.empty())
+    load_cache(cache_path);
+
+  std::map<std::string, CardProfile> found;
+
+  if ((err = enumerate_cards(found)) < 0)
+    return err;
+
+  cards.swap(found);
+
+  if ((err = enumerate_endpoints()) < 0)
+    return err;
+
+  //A card is reused from the cache only if it is the same card with the
+  //same endpoints; anything else is probed again.
+  std::vector<CardProfile*> stale;
+
+  for (auto& entry : cards)
+  {
+    CardProfile& card = entry.second;
+    auto cached = cached_cards.find(card.id);
+    bool reusable = (cached != cached_cards.end() && cached->second.complete && cached->second.fingerprint == card.fingerprint && cached->second.endpoints.size() == card.endpoints.size());
+
+    for (auto& endpoint : card.endpoints)
+    {
+      if (!reusable)
+        break;
+
+      auto cached_endpoint = cached->second.endpoints.find(endpoint.first);
+
+      if (cached_endpoint == cached->second.endpoints.end())
+      {
+        reusable = false;
+        break;
+      }
+
+      endpoint.second.playback_caps = cached_endpoint->second.playback_caps;
+      endpoint.second.capture_caps = cached_endpoint->second.capture_caps;
+    }
+
+    if (reusable)
+    {
+      card.mixer_elements = cached->second.mixer_elements;
+      card.complete = true;
+    }
+    else
+    {
+      stale.push_back(&card);
+    }
+  }
+
+  probe_cards(stale);
+
+  for (PCMEndpoint& endpoint : endpoints)
+  {
+    auto card = cards.find(endpoint.card_id);
+
+    if (card == cards.end())
+      continue;
+
+    auto probed = card->second.endpoints.find(endpoint.name);
+
+    if (probed != card->second.endpoints.end())
+    {
+      endpoint.playback_caps = probed->second.playback_caps;
+      endpoint.capture_caps = probed->second.capture_caps;
+    }
+  }
+
+  if (!cache_path.empty() && !stale.empty())
+    save_cache(cache_path);
+
+  return static_cast<int>(endpoints.size());
+}
+
+void DeviceCatalog::set_probe_threads(unsigned int threads)
+{
+  probe_threads = threads;
+}
+
+const std::vector<PCMEndpoint>& DeviceCatalog::get_endpoints()
+{
+  return endpoints;
+}
+
+const PCMEndpoint* DeviceCatalog::find_endpoint(std::string name)
+{
+  for (const PCMEndpoint& endpoint : endpoints)
+  {
+    if (endpoint.name == name)
+      return &endpoint;
+  }
+
+  return nullptr;
+}
+
+const CardProfile* DeviceCatalog::find_card(std::string card_id)
+{
+  auto card = cards.find(card_id);
+  return (card != cards.end()) ? &card->second : nullptr;
+}
+
+bool DeviceCatalog::card_exists(std::string card_id)
+{
+  return cards.count(card_id) > 0;
+}
+
+bool DeviceCatalog::mixer_element_exists(std::string card_id, std::string element_name)
+{
+  const CardProfile* card = find_card(card_id);
+
+  if (card == nullptr)
+    return false;
+
+  return std::find(card->mixer_elements.begin(), card->mixer_elements.end(), element_name) != card->mixer_elements.end();
+}
+
+//Reads complete card profiles written by save_cache. A missing file is not
+//an error worth reporting - it is simply a cold start.
+int DeviceCatalog::load_cache(std::string cache_path)
+{
+  std::ifstream in(cache_path);
+
+  if (!in.is_open())
+    return -ENOENT;
+
+  std::string line;
+
+  if (!std::getline(in, line) || line != CACHE_HEADER)
+  {
+    handle_error_code(-EINVAL, false, "Ignoring device cache in an unknown format.", cache_path.c_str());
+    return -EINVAL;
+  }
+
+  std::map<std::string, CardProfile> loaded;
+  CardProfile* card = nullptr;
+  PCMEndpoint* endpoint = nullptr;
+  PCMCapabilities* caps = nullptr;
+
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string keyword;
+    fields >> keyword;
+
+    if (keyword == "card")
+    {
+      std::string id = line_value(line, keyword);
+      card = &loaded[id];
+      card->id = id;
+      card->complete = true;
+      endpoint = nullptr;
+      caps = nullptr;
+    }
+    else if (card == nullptr)
+    {
+      continue;
+    }
+    else if (keyword == "fingerprint")
+    {
+      card->fingerprint = line_value(line, keyword);
+    }
+    else if (keyword == "mixer_element")
+    {
+      card->mixer_elements.push_back(line_value(line, keyword));
+    }
+    else if (keyword == "endpoint")
+    {
+      PCMEndpoint entry;
+      int playback = 0, capture = 0;
+      fields >> entry.name >> playback >> capture;
+      entry.card_id = card->id;
+      entry.playback = (playback != 0);
+      entry.capture = (capture != 0);
+      endpoint = &(card->endpoints[entry.name] = entry);
+      caps = nullptr;
+    }
+    else if (endpoint == nullptr)
+    {
+      continue;
+    }
+    else if (keyword == "caps")
+    {
+      std::string direction;
+      fields >> direction;
+      caps = (direction == "capture") ? &endpoint->capture_caps : &endpoint->playback_caps;
+      caps->probed = true;
+    }
+    else if (caps == nullptr)
+    {
+      continue;
+    }
+    else if (keyword == "access")
+    {
+      int access;
+
+      while (fields >> access)
+        caps->access_types.push_back(static_cast<snd_pcm_access_t>(access));
+    }
+    else if (keyword == "formats")
+    {
+      int format;
+
+      while (fields >> format)
+        caps->formats.push_back(static_cast<snd_pcm_format_t>(format));
+    }
+    else if (keyword == "rates")
+    {
+      unsigned int rate;
+
+      while (fields >> rate)
+        caps->rates.push_back(rate);
+    }
+    else if (keyword == "rate_range")
+    {
+      fields >> caps->rate_min >> caps->rate_max;
+    }
+    else if (keyword == "channels")
+    {
+      fields >> caps->channels_min >> caps->channels_max;
+    }
+    else if (keyword == "period_size")
+    {
+      fields >> caps->period_size_min >> caps->period_size_max;
+    }
+    else if (keyword == "periods")
+    {
+      fields >> caps->periods_min >> caps->periods_max;
+    }
+    else if (keyword == "buffer_size")
+    {
+      fields >> caps->buffer_size_min >> caps->buffer_size_max;
+    }
+  }
+
+  cached_cards.swap(loaded);
+  return 0;
+}
+
+//Writes every completely probed card, including cached ones that aren't
+//plugged in right now, so a USB device coming back isn't probed again.
+//The file is replaced atomically.
+int DeviceCatalog::save_cache(std::string cache_path)
+{
+  std::map<std::string, const CardProfile*> complete;
+
+  for (const auto& entry : cached_cards)
+    complete[entry.first] = &entry.second;
+
+  for (const auto& entry : cards)
+  {
+    if (entry.second.complete)
+      complete[entry.first] = &entry.second;
+  }
+
+  std::string temp_path = cache_path + ".tmp";
+  std::ofstream out(temp_path, std::ios::trunc);
+
+  if (!out.is_open())
+  {
+    handle_error_code(-EACCES, false, "Cannot write device cache.", temp_path.c_str());
+    return -EACCES;
+  }
+
+  out << CACHE_HEADER << "\n";
+
+  for (const auto& entry : complete)
+  {
+    const CardProfile& card = *entry.second;
+    out << "card " << card.id << "\n";
+    out << "fingerprint " << card.fingerprint << "\n";
+
+    for (const std::string& element : card.mixer_elements)
+      out << "mixer_element " << element << "\n";
+
+    for (const auto& endpoint : card.endpoints)
+    {
+      out << "endpoint " << endpoint.second.name << " " << (endpoint.second.playback ? 1 : 0) << " " << (endpoint.second.capture ? 1 : 0) << "\n";
+
+      if (endpoint.second.playback_caps.probed)
+        write_caps(out, "playback", endpoint.second.playback_caps);
+
+      if (endpoint.second.capture_caps.probed)
+        write_caps(out, "capture", endpoint.second.capture_caps);
+    }
+  }
+
+  out.close();
+
+  if (out.fail() || std::rename(temp_path.c_str(), cache_path.c_str()) != 0)
+  {
+    handle_error_code(-EIO, false, "Cannot write device cache.", cache_path.c_str());
+    std::remove(temp_path.c_str());
+    return -EIO;
+  }
+
+  return 0;
+}
+
+//Card IDs and fingerprints come from each card's control interface, which
+//opens without touching the PCM or mixer state.
+int DeviceCatalog::enumerate_cards(std::map<std::string, CardProfile>& found)
+{
+  int err;
+  int card_index = -1;
+  snd_ctl_card_info_t* card_info;
+  snd_ctl_card_info_alloca(&card_info);
+
+  while ((err = snd_card_next(&card_index)) >= 0 && card_index >= 0)
+  {
+    char ctl_name[32];
+    snprintf(ctl_name, sizeof(ctl_name), "hw:%d", card_index);
+    snd_ctl_t* ctl_handle;
+
+    if ((err = snd_ctl_open(&ctl_handle, ctl_name, 0)) < 0)
+    {
+      handle_error_code(err, false, "Cannot open control interface of sound card.", ctl_name);
+      continue;
+    }
+
+    if ((err = snd_ctl_card_info(ctl_handle, card_info)) < 0)
+    {
+      handle_error_code(err, false, "Cannot read sound card information.", ctl_name);
+    }
+    else
+    {
+      CardProfile& card = found[snd_ctl_card_info_get_id(card_info)];
+      card.id = snd_ctl_card_info_get_id(card_info);
+      card.fingerprint = std::string(snd_ctl_card_info_get_driver(card_info)) + " " + snd_ctl_card_info_get_longname(card_info);
+      card.complete = false;
+    }
+
+    snd_ctl_close(ctl_handle);
+  }
+
+  if (err < 0)
+  {
+    handle_error_code(err, false, "Cannot enumerate sound cards.");
+    return err;
+  }
+
+  return 0;
+}
+
+int DeviceCatalog::enumerate_endpoints()
+{
+  int err;
+  void** hints;
+
+  if ((err = snd_device_name_hint(-1, "pcm", &hints)) < 0)
+  {
+    handle_error_code(err, false, "Cannot list PCM devices.");
+    return err;
+  }
+
+  endpoints.clear();
+
+  for (void** hint = hints; *hint != NULL; hint++)
+  {
+    char* name = snd_device_name_get_hint(*hint, "NAME");
+    char* description = snd_device_name_get_hint(*hint, "DESC");
+    char* io_direction = snd_device_name_get_hint(*hint, "IOID"); //NULL means both
+
+    if (name != NULL && strcmp(name, "null") != 0)
+    {
+      PCMEndpoint endpoint;
+      endpoint.name = name;
+      endpoint.description = (description != NULL) ? description : "";
+      endpoint.card_id = card_id_of(endpoint.name);
+      endpoint.playback = (io_direction == NULL || strcmp(io_direction, "Output") == 0);
+      endpoint.capture = (io_direction == NULL || strcmp(io_direction, "Input") == 0);
+      endpoints.push_back(endpoint);
+
+      auto card = cards.find(endpoint.card_id);
+
+      if (endpoint.name.compare(0, 3, "hw:") == 0 && card != cards.end())
+        card->second.endpoints[endpoint.name] = endpoint;
+    }
+
+    free(name);
+    free(description);
+    free(io_direction);
+  }
+
+  snd_device_name_free_hint(hints);
+  return 0;
+}
+
+//One job per endpoint direction and one per card mixer, spread over a
+//small thread pool. Every job writes only its own endpoint's or card's
+//results, so they need no locking.
+void DeviceCatalog::probe_cards(std::vector<CardProfile*>& stale)
+{
+  std::vector<ProbeJob> jobs;
+
+  for (CardProfile* card : stale)
+  {
+    jobs.push_back({ card, nullptr, SND_PCM_STREAM_PLAYBACK, 0 });
+
+    for (auto& entry : card->endpoints)
+    {
+      entry.second.playback_caps = PCMCapabilities();
+      entry.second.capture_caps = PCMCapabilities();
+
+      if (entry.second.playback)
+        jobs.push_back({ card, &entry.second, SND_PCM_STREAM_PLAYBACK, 0 });
+
+      if (entry.second.capture)
+        jobs.push_back({ card, &entry.second, SND_PCM_STREAM_CAPTURE, 0 });
+    }
+  }
+
+  if (jobs.empty())
+    return;
+
+  unsigned int thread_count = (probe_threads > 0) ? probe_threads : std::thread::hardware_concurrency();
+  thread_count = std::max(1u, std::min<unsigned int>(thread_count, jobs.size()));
+  std::atomic<size_t> next_job(0);
+
+  auto worker = [&jobs, &next_job]()
+  {
+    size_t index;
+
+    while ((index = next_job.fetch_add(1)) < jobs.size())
+    {
+      ProbeJob& job = jobs[index];
+
+      if (job.endpoint == nullptr)
+        job.result = probe_mixer(job.card->id, job.card->mixer_elements);
+      else if (job.stream_type == SND_PCM_STREAM_PLAYBACK)
+        job.result = probe_endpoint(job.endpoint->name, job.stream_type, job.endpoint->playback_caps);
+      else
+        job.result = probe_endpoint(job.endpoint->name, job.stream_type, job.endpoint->capture_caps);
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  for (unsigned int i = 1; i < thread_count; i++)
+    threads.push_back(std::thread(worker));
+
+  worker();
+
+  for (std::thread& thread : threads)
+    thread.join();
+
+  //A card with a busy endpoint stays out of the cache and is probed again
+  //on the next scan.
+  for (CardProfile* card : stale)
+    card->complete = true;
+
+  for (const ProbeJob& job : jobs)
+  {
+    if (job.result < 0)
+      job.card->complete = false;
+  }
+}
@@ -1,14 +1,303 @@
 #include <alsaplusplus/error.hpp>
 
-void AlsaPlusPlus::handle_error_code(int err_code, bool throws, std::string error_desc)
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <semaphore.h>
+
+using namespace AlsaPlusPlus;
+
+namespace
 {
-  std::cerr << error_desc << " (ALSA Description: " << snd_strerror(err_code) << ")" << std::endl;
+  constexpr size_t ERROR_QUEUE_SLOTS = 256; //power of two
+
+  class AlsaErrorCategory :
+    public std::error_category
+  {
+    public:
+      const char* name() const noexcept override
+      {
+        return "alsa";
+      }
+
+      std::string message(int ev) const override
+      {
+        return snd_strerror(ev);
+      }
+
+      std::error_condition default_error_condition(int ev) const noexcept override
+      {
+        if (ev < SND_ERROR_BEGIN)
+          return std::error_condition(ev, std::generic_category());
+
+        return std::error_condition(ev, *this);
+      }
+  };
+
+  void print_error(const ErrorEvent& event)
+  {
+    std::cerr << event.description;
+
+    if (event.context[0] != '\0')
+      std::cerr << " [" << event.context << "]";
+
+    std::cerr << " (ALSA Description: " << snd_strerror(event.code) << ")" << std::endl;
+  }
+
+  //Bounded multi-producer queue after Dmitry Vyukov's design: each slot's
+  //sequence number says whether it is free for the producer at that
+  //position or holds an event for the consumer. Consumers are serialised by
+  //sink_mutex, so popping needs no CAS. Producers wake the drain thread
+  //with sem_post, which neither locks nor allocates.
+  class ErrorQueue
+  {
+    public:
+      ErrorQueue() :
+        enqueue_pos(0),
+        dequeue_pos(0),
+        dropped(0),
+        drain_started(false)
+      {
+        for (size_t i = 0; i < ERROR_QUEUE_SLOTS; i++)
+          slots[i].sequence.store(i, std::memory_order_relaxed);
+
+        sem_init(&drain_signal, 0, 0);
+      }
+
+      void start_drain()
+      {
+        if (drain_started.load(std::memory_order_acquire))
+          return;
+
+        std::lock_guard<std::mutex> lock(start_mutex);
+
+        if (drain_started.load(std::memory_order_relaxed))
+          return;
+
+        std::thread(&ErrorQueue::drain_loop, this).detach();
+        drain_started.store(true, std::memory_order_release);
+      }
+
+      //fork() copies only the calling thread: hold sink_mutex across it so
+      //the child doesn't inherit it locked by the drain thread, and let the
+      //child start a drainer of its own when it needs one.
+      void before_fork()
+      {
+        sink_mutex.lock();
+      }
+
+      void after_fork_parent()
+      {
+        sink_mutex.unlock();
+      }
+
+      void after_fork_child()
+      {
+        sink_mutex.unlock();
+        drain_started.store(false, std::memory_order_relaxed);
+      }
+
+      void push(const ErrorEvent& event)
+      {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+          Slot& slot = slots[pos & (ERROR_QUEUE_SLOTS - 1)];
+          size_t sequence = slot.sequence.load(std::memory_order_acquire);
+          intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+          if (diff == 0)
+          {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+              slot.event = event;
+              slot.sequence.store(pos + 1, std::memory_order_release);
+              sem_post(&drain_signal);
+              return;
+            }
+          }
+          else if (diff < 0)
+          {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+          }
+          else
+          {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      void drain()
+      {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        ErrorEvent event;
+
+        while (pop(event))
+        {
+          if (sink)
+            sink(event);
+          else
+            print_error(event);
+        }
+      }
+
+      void set_sink(ErrorSink new_sink)
+      {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sink = new_sink;
+      }
+
+      uint64_t get_dropped()
+      {
+        return dropped.load(std::memory_order_relaxed);
+      }
+
+    private:
+      struct Slot
+      {
+        std::atomic<size_t> sequence;
+        ErrorEvent event;
+      };
+
+      bool pop(ErrorEvent& event)
+      {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos & (ERROR_QUEUE_SLOTS - 1)];
+
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+          return false;
+
+        event = slot.event;
+        slot.sequence.store(pos + ERROR_QUEUE_SLOTS, std::memory_order_release);
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+
+        return true;
+      }
+
+      void drain_loop()
+      {
+        while (true)
+        {
+          if (sem_wait(&drain_signal) < 0 && errno == EINTR)
+            continue;
+
+          drain();
+        }
+      }
+
+      Slot slots[ERROR_QUEUE_SLOTS];
+      std::atomic<size_t> enqueue_pos;
+      std::atomic<size_t> dequeue_pos;
+      std::atomic<uint64_t> dropped;
+      std::mutex sink_mutex;
+      ErrorSink sink;
+      sem_t drain_signal;
+      std::atomic<bool> drain_started;
+      std::mutex start_mutex;
+  };
+
+  ErrorQueue& error_queue();
+
+  void flush_at_exit()
+  {
+    flush_errors();
+  }
+
+  void queue_before_fork()
+  {
+    error_queue().before_fork();
+  }
+
+  void queue_after_fork_parent()
+  {
+    error_queue().after_fork_parent();
+  }
+
+  void queue_after_fork_child()
+  {
+    error_queue().after_fork_child();
+  }
+
+  //Never destroyed, so errors reported from other static destructors still
+  //have somewhere to go; whatever is queued at exit is flushed by atexit.
+  ErrorQueue& error_queue()
+  {
+    static ErrorQueue* queue = []()
+    {
+      ErrorQueue* created = new ErrorQueue();
+      std::atexit(flush_at_exit);
+      pthread_atfork(queue_before_fork, queue_after_fork_parent, queue_after_fork_child);
+      return created;
+    }();
+
+    return *queue;
+  }
+}
+
+const std::error_category& AlsaPlusPlus::alsa_category()
+{
+  static AlsaErrorCategory category;
+  return category;
+}
+
+std::error_code AlsaPlusPlus::make_alsa_error_code(int err_code)
+{
+  return std::error_code(err_code < 0 ? -err_code : err_code, alsa_category());
+}
+
+void AlsaPlusPlus::start_error_drain()
+{
+  error_queue().start_drain();
+}
+
+void AlsaPlusPlus::set_error_sink(ErrorSink sink)
+{
+  error_queue().set_sink(sink);
+  error_queue().start_drain();
+}
+
+void AlsaPlusPlus::flush_errors()
+{
+  error_queue().drain();
+}
+
+uint64_t AlsaPlusPlus::get_dropped_error_count()
+{
+  return error_queue().get_dropped();
+}
+
+void AlsaPlusPlus::handle_error_code(int err_code, bool throws, const char* error_desc, const char* context)
+{
+  ErrorEvent event;
+  event.code = err_code;
+  event.description = error_desc;
+  event.context[0] = '\0';
+  event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+  if (context != nullptr)
+  {
+    strncpy(event.context, context, sizeof(event.context) - 1);
+    event.context[sizeof(event.context) - 1] = '\0';
+  }
+
+  error_queue().push(event);
 
   if (throws)
   {
-    std::error_code ec(err_code, std::generic_category());
-    std::system_error se(ec, error_desc);
+    std::string what(error_desc);
+
+    if (event.context[0] != '\0')
+      what += std::string(" [") + event.context + "]";
 
-    throw se;
+    throw std::system_error(make_alsa_error_code(err_code), what);
   }
 }
@@ -0,0 +1,295 @@
+#include <alsaplusplus/event_loop.hpp>
+
+extern "C"
+{
+#include <sys/eventfd.h>
+}
+
+using namespace AlsaPlusPlus;
+
+//Upper bound on descriptors reported by a single epoll_wait call.
+constexpr size_t MAX_EVENTS_PER_WAIT = 64;
+
+PCMEventLoop::PCMEventLoop() :
+  running(false),
+  dispatching(false),
+  events(MAX_EVENTS_PER_WAIT)
+{
+  if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    handle_error_code(-errno, true, "Cannot create epoll instance for PCM event loop.");
+
+  if ((wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+  {
+    int wake_err = -errno;
+    close(epoll_fd);
+    handle_error_code(wake_err, true, "Cannot create wakeup descriptor for PCM event loop.");
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr; //The wakeup descriptor has no slot.
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0)
+  {
+    int ctl_err = -errno;
+    close(wake_fd);
+    close(epoll_fd);
+    handle_error_code(ctl_err, true, "Cannot register wakeup descriptor with PCM event loop.");
+  }
+}
+
+PCMEventLoop::~PCMEventLoop()
+{
+  close(wake_fd);
+  close(epoll_fd);
+}
+
+int PCMEventLoop::add_device(PCMDevice& device, PCMEventHandler handler)
+{
+  std::unique_ptr<Registration> reg(new Registration());
+  reg->device = &device;
+  reg->handler = handler;
+  reg->pending = false;
+  reg->removed = false;
+
+  int err;
+
+  if ((err = device.poll_descriptors(reg->fds)) < 0)
+    return err;
+
+  reg->slots.resize(reg->fds.size());
+
+  for (unsigned int i = 0; i < reg->fds.size(); i++)
+  {
+    reg->slots[i].owner = reg.get();
+    reg->slots[i].index = i;
+
+    //POLLIN/POLLOUT/POLLERR share their values with the EPOLL equivalents.
+    struct epoll_event ev;
+    ev.events = reg->fds[i].events;
+    ev.data.ptr = &reg->slots[i];
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, reg->fds[i].fd, &ev) < 0)
+    {
+      err = -errno;
+
+      for (unsigned int j = 0; j < i; j++)
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, reg->fds[j].fd, nullptr);
+
+      handle_error_code(err, false, "Cannot register PCM poll descriptor with event loop.");
+      return err;
+    }
+  }
+
+  //A prepared capture stream never becomes readable on its own.
+  if (device.get_stream_direction() == SND_PCM_STREAM_CAPTURE)
+    device.start();
+
+  pending_registrations.reserve(registrations.size() + 1);
+  registrations.push_back(std::move(reg));
+  return 0;
+}
+
+int PCMEventLoop::remove_device(PCMDevice& device)
+{
+  for (auto it = registrations.begin(); it != registrations.end(); ++it)
+  {
+    if ((*it)->device == &device && !(*it)->removed)
+    {
+      for (auto& fd : (*it)->fds)
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd.fd, nullptr);
+
+      //Handlers may remove devices mid-dispatch; make sure run_once does not
+      //visit the registration after it is freed.
+      for (auto& pending : pending_registrations)
+      {
+        if (pending == it->get())
+          pending = nullptr;
+      }
+
+      //The handler running now may be this registration's own; it is freed
+      //once run_once has finished dispatching.
+      if (dispatching)
+        (*it)->removed = true;
+      else
+        registrations.erase(it);
+
+      return 0;
+    }
+  }
+
+  handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "PCM device is not registered with this event loop.");
+  return -static_cast<int>(std::errc::invalid_argument);
+}
+
+//Waits up to timeout_ms (-1 = forever) and dispatches every ready device once.
+//Returns the number of handlers invoked, or a negative error code.
+int PCMEventLoop::run_once(int timeout_ms)
+{
+  int count = epoll_wait(epoll_fd, events.data(), events.size(), timeout_ms);
+
+  if (count < 0)
+  {
+    if (errno == EINTR)
+      return 0;
+
+    int err = -errno;
+    handle_error_code(err, false, "Waiting on PCM event loop failed.");
+    return err;
+  }
+
+  pending_registrations.clear();
+
+  for (int i = 0; i < count; i++)
+  {
+    DescriptorSlot* slot = static_cast<DescriptorSlot*>(events[i].data.ptr);
+
+    if (slot == nullptr)
+    {
+      uint64_t wake_count;
+
+      if (read(wake_fd, &wake_count, sizeof(wake_count)) < 0)
+      {
+        //Nothing to drain - the counter was already reset.
+      }
+
+      continue;
+    }
+
+    slot->owner->fds[slot->index].revents = events[i].events;
+
+    if (!slot->owner->pending)
+    {
+      slot->owner->pending = true;
+      pending_registrations.push_back(slot->owner);
+    }
+  }
+
+  int dispatched = 0;
+
+  for (size_t i = 0; i < pending_registrations.size(); i++)
+  {
+    Registration* reg = pending_registrations[i];
+
+    if (reg == nullptr)
+      continue; //Removed by an earlier handler.
+
+    dispatching = true;
+    int err = dispatch(*reg);
+    dispatching = false;
+
+    if (err < 0)
+    {
+      //Devices not reached yet must be queueable again; epoll is level
+      //triggered, so the next run_once reports them afresh.
+      for (size_t j = i + 1; j < pending_registrations.size(); j++)
+      {
+        if (pending_registrations[j] == nullptr)
+          continue;
+
+        pending_registrations[j]->pending = false;
+
+        for (auto& fd : pending_registrations[j]->fds)
+          fd.revents = 0;
+      }
+
+      pending_registrations.clear();
+      reap_removed();
+      return err;
+    }
+
+    if (err > 0)
+      dispatched++;
+  }
+
+  reap_removed();
+  return dispatched;
+}
+
+//Frees the registrations whose handlers removed them during dispatch.
+void PCMEventLoop::reap_removed()
+{
+  for (auto it = registrations.begin(); it != registrations.end();)
+  {
+    if ((*it)->removed)
+      it = registrations.erase(it);
+    else
+      ++it;
+  }
+}
+
+int PCMEventLoop::dispatch(Registration& reg)
+{
+  reg.pending = false;
+
+  unsigned short revents = 0;
+  int err = reg.device->poll_revents(reg.fds.data(), reg.fds.size(), revents);
+
+  for (auto& fd : reg.fds)
+    fd.revents = 0;
+
+  if (err < 0)
+    return err;
+
+  if (revents == 0)
+    return 0; //Woken by a plugin descriptor without a real state change.
+
+  snd_pcm_sframes_t avail = reg.device->avail_update();
+
+  if (avail < 0 || (revents & POLLERR))
+  {
+    if ((err = reg.device->recover(avail < 0 ? avail : -EPIPE)) < 0)
+    {
+      if (err == -EAGAIN)
+        return 0; //Still suspended - try again on the next wakeup.
+
+      handle_error_code(err, false, "Cannot recover PCM device in event loop.");
+      return err;
+    }
+
+    if (reg.device->get_stream_direction() == SND_PCM_STREAM_CAPTURE)
+      reg.device->start();
+
+    if ((avail = reg.device->avail_update()) < 0)
+      return 0; //Still settling - poll will report it again.
+  }
+
+  if (avail == 0)
+    return 0;
+
+  if ((err = reg.handler(*reg.device, avail)) < 0)
+    return err;
+
+  return 1;
+}
+
+int PCMEventLoop::run()
+{
+  running = true;
+
+  while (running)
+  {
+    int err = run_once(-1);
+
+    if (err < 0)
+    {
+      running = false;
+      return err;
+    }
+  }
+
+  return 0;
+}
+
+//Safe to call from any thread, including from inside a handler.
+void PCMEventLoop::stop()
+{
+  running = false;
+
+  uint64_t one = 1;
+
+  if (write(wake_fd, &one, sizeof(one)) < 0)
+  {
+    //Counter saturated - a wakeup is already pending.
+  }
+}
@@ -0,0 +1,200 @@
+#include <alsaplusplus/gain.hpp>
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ALSAPLUSPLUS_GAIN_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ALSAPLUSPLUS_GAIN_NEON
+#endif
+
+using namespace AlsaPlusPlus;
+
+namespace
+{
+  //Above the threshold t, x maps to t + (1 - t) * tanh((x - t) / (1 - t)):
+  //continuous in value and slope at t and saturating at full scale. tanh
+  //is the (3,2) Pade approximant, which is exact enough below u = 3 and
+  //saturates to 1 beyond.
+  inline float soft_limit(float x, float threshold)
+  {
+    float magnitude = std::fabs(x);
+
+    if (magnitude <= threshold)
+      return x;
+
+    float knee = 1.0f - threshold;
+    float u = (magnitude - threshold) / knee;
+    float shaped = (u >= 3.0f) ? 1.0f : u * (27.0f + u * u) / (27.0f + 9.0f * u * u);
+
+    return std::copysign(threshold + knee * shaped, x);
+  }
+
+  void scale_scalar(const float* input, float* output, size_t samples, float gain)
+  {
+    for (size_t i = 0; i < samples; i++)
+      output[i] = input[i] * gain;
+  }
+
+  void limit_scalar(float* samples, size_t count, float threshold)
+  {
+    for (size_t i = 0; i < count; i++)
+      samples[i] = soft_limit(samples[i], threshold);
+  }
+
+#if defined(ALSAPLUSPLUS_GAIN_X86)
+  __attribute__((target("sse2"))) void scale(const float* input, float* output, size_t samples, float gain)
+  {
+    const __m128 v_gain = _mm_set1_ps(gain);
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4)
+      _mm_storeu_ps(output + i, _mm_mul_ps(_mm_loadu_ps(input + i), v_gain));
+
+    scale_scalar(input + i, output + i, samples - i, gain);
+  }
+
+  //Peaks are rare, so blocks of four under the threshold are skipped with
+  //one compare and the shaping runs only where it is needed.
+  __attribute__((target("sse2"))) void limit(float* samples, size_t count, float threshold)
+  {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 v_threshold = _mm_set1_ps(threshold);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128 magnitude = _mm_and_ps(_mm_loadu_ps(samples + i), abs_mask);
+
+      if (_mm_movemask_ps(_mm_cmpgt_ps(magnitude, v_threshold)) != 0)
+        limit_scalar(samples + i, 4, threshold);
+    }
+
+    limit_scalar(samples + i, count - i, threshold);
+  }
+#elif defined(ALSAPLUSPLUS_GAIN_NEON)
+  void scale(const float* input, float* output, size_t samples, float gain)
+  {
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4)
+      vst1q_f32(output + i, vmulq_n_f32(vld1q_f32(input + i), gain));
+
+    scale_scalar(input + i, output + i, samples - i, gain);
+  }
+
+  void limit(float* samples, size_t count, float threshold)
+  {
+    const float32x4_t v_threshold = vdupq_n_f32(threshold);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+      if (vmaxvq_u32(vcagtq_f32(vld1q_f32(samples + i), v_threshold)) != 0)
+        limit_scalar(samples + i, 4, threshold);
+    }
+
+    limit_scalar(samples + i, count - i, threshold);
+  }
+#else
+  void scale(const float* input, float* output, size_t samples, float gain)
+  {
+    scale_scalar(input, output, samples, gain);
+  }
+
+  void limit(float* samples, size_t count, float threshold)
+  {
+    limit_scalar(samples, count, threshold);
+  }
+#endif
+}
+
+GainStage::GainStage() :
+  target_gain(1.0f),
+  target_ramp_frames(0),
+  target_generation(0),
+  limiter_enabled(false),
+  limiter_threshold(0.9f),
+  applied_generation(0),
+  current_gain(1.0f),
+  ramp_step(0.0f),
+  ramp_end(1.0f),
+  ramp_remaining(0)
+{
+}
+
+void GainStage::set_target(float gain, uint32_t ramp_frames)
+{
+  target_gain.store(gain, std::memory_order_relaxed);
+  target_ramp_frames.store(ramp_frames, std::memory_order_relaxed);
+  target_generation.fetch_add(1, std::memory_order_release);
+}
+
+float GainStage::get_target() const
+{
+  return target_gain.load(std::memory_order_relaxed);
+}
+
+void GainStage::set_limiter(bool enabled, float threshold)
+{
+  if (threshold <= 0.0f || threshold >= 1.0f)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Limiter threshold must be between 0 and 1.");
+    return;
+  }
+
+  limiter_threshold.store(threshold, std::memory_order_relaxed);
+  limiter_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool GainStage::is_bypassed() const
+{
+  return current_gain == 1.0f && ramp_remaining == 0 &&
+    target_generation.load(std::memory_order_acquire) == applied_generation &&
+    !limiter_enabled.load(std::memory_order_relaxed);
+}
+
+void GainStage::process(const float* input, float* output, size_t frame_count, unsigned int channels)
+{
+  uint32_t generation = target_generation.load(std::memory_order_acquire);
+
+  if (generation != applied_generation)
+  {
+    applied_generation = generation;
+    ramp_end = target_gain.load(std::memory_order_relaxed);
+    ramp_remaining = target_ramp_frames.load(std::memory_order_relaxed);
+
+    if (ramp_remaining == 0)
+      current_gain = ramp_end;
+    else
+      ramp_step = (ramp_end - current_gain) / ramp_remaining;
+  }
+
+  size_t frame = 0;
+
+  //Ramps are short, so they run per frame; the settled gain below is one
+  //vector multiply over the rest of the block.
+  for (; frame < frame_count && ramp_remaining > 0; frame++)
+  {
+    current_gain += ramp_step;
+
+    if (--ramp_remaining == 0)
+      current_gain = ramp_end;
+
+    for (unsigned int channel = 0; channel < channels; channel++)
+      output[frame * channels + channel] = input[frame * channels + channel] * current_gain;
+  }
+
+  size_t offset = frame * channels;
+  size_t samples = frame_count * channels;
+
+  if (current_gain != 1.0f)
+    scale(input + offset, output + offset, samples - offset, current_gain);
+  else if (input != output)
+    memcpy(output + offset, input + offset, (samples - offset) * sizeof(float));
+
+  if (limiter_enabled.load(std::memory_order_relaxed))
+    limit(output, samples, limiter_threshold.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,79 @@
+#include <alsaplusplus/latency_solver.hpp>
+
+#include <algorithm>
+
+using namespace AlsaPlusPlus;
+
+//Beyond this many periods per buffer the extra wakeups buy nothing.
+constexpr unsigned int SOLVER_MAX_PERIODS = 64;
+
+static snd_pcm_uframes_t power_of_two_below(snd_pcm_uframes_t frames)
+{
+  snd_pcm_uframes_t power = 1;
+
+  while (power <= frames / 2)
+    power *= 2;
+
+  return power;
+}
+
+std::vector<BufferLayout> AlsaPlusPlus::rank_buffer_layouts(const HwRanges& ranges, const LatencyTarget& target)
+{
+  std::vector<BufferLayout> layouts;
+
+  if (ranges.sample_rate_hz == 0)
+    return layouts;
+
+  uint64_t target_frames = (static_cast<uint64_t>(ranges.sample_rate_hz) * target.latency_us) / 1000000;
+  snd_pcm_uframes_t min_size = std::max<snd_pcm_uframes_t>(1, ranges.period_size_min);
+  snd_pcm_uframes_t max_size = ranges.period_size_max;
+
+  //A period shorter than this wakes the application too often.
+  if (target.max_wakeups_per_s > 0)
+    min_size = std::max<snd_pcm_uframes_t>(min_size, (ranges.sample_rate_hz + target.max_wakeups_per_s - 1) / target.max_wakeups_per_s);
+
+  if (min_size > max_size)
+    return layouts;
+
+  unsigned int min_periods = std::max(std::max(target.min_periods, ranges.periods_min), 1u);
+  unsigned int max_periods = std::min(ranges.periods_max, SOLVER_MAX_PERIODS);
+
+  for (unsigned int periods = min_periods; periods <= max_periods; periods++)
+  {
+    snd_pcm_uframes_t exact = (target_frames + periods / 2) / periods;
+    snd_pcm_uframes_t lower = power_of_two_below(std::max<snd_pcm_uframes_t>(exact, 1));
+    snd_pcm_uframes_t candidates[3] = { exact, lower, (lower == exact) ? exact : lower * 2 };
+
+    for (int i = 0; i < 3; i++)
+    {
+      snd_pcm_uframes_t size = std::max(min_size, std::min(candidates[i], max_size));
+      snd_pcm_uframes_t buffer = size * periods;
+
+      if (buffer < ranges.buffer_size_min || buffer > ranges.buffer_size_max)
+        continue;
+
+      bool duplicate = false;
+
+      for (const BufferLayout& layout : layouts)
+        duplicate = duplicate || (layout.period_size == size && layout.periods == periods);
+
+      if (!duplicate)
+        layouts.push_back({ size, periods });
+    }
+  }
+
+  std::stable_sort(layouts.begin(), layouts.end(), [target_frames](const BufferLayout& a, const BufferLayout& b)
+  {
+    uint64_t a_buffer = a.period_size * a.periods;
+    uint64_t b_buffer = b.period_size * b.periods;
+    uint64_t a_error = (a_buffer > target_frames) ? a_buffer - target_frames : target_frames - a_buffer;
+    uint64_t b_error = (b_buffer > target_frames) ? b_buffer - target_frames : target_frames - b_buffer;
+
+    if (a_error != b_error)
+      return a_error < b_error;
+
+    return a.period_size > b.period_size;
+  });
+
+  return layouts;
+}
@@ -10,6 +10,8 @@ Mixer::Mixer(std::string hw_device, std::string volume_element_name) :
   device_name(hw_device),
   simple_elem_name(volume_element_name)
 {
+  start_error_drain();
+
   if ((err = snd_mixer_open(&mixer_handle, 0)) < 0)
     handle_error_code(err, true, "Cannot open handle to mixer device.");
 
@@ -29,9 +31,7 @@ Mixer::Mixer(std::string hw_device, std::string volume_element_name) :
 
   if (element_handle == NULL)
   {
-    std::ostringstream oss;
-    oss << "Could not find simple mixer element named " << simple_elem_name << ".";
-    handle_error_code(static_cast<int>(std::errc::argument_out_of_domain), true, oss.str());
+    handle_error_code(static_cast<int>(std::errc::argument_out_of_domain), true, "Could not find simple mixer element.", simple_elem_name.c_str());
   }
   if ((err = snd_mixer_selem_set_playback_volume_range (element_handle, MINIMAL_VOLUME, MAXIMUM_VOLUME)) < 0)
     handle_error_code(err, true, "Cannot set element volume range.");
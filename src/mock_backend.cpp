@@ -0,0 +1,763 @@
+#include <alsaplusplus/mock_backend.hpp>
+
+#include <algorithm>
+
+using namespace AlsaPlusPlus;
+
+static snd_htimestamp_t frames_to_timestamp(uint64_t frames, unsigned int rate)
+{
+  snd_htimestamp_t ts;
+  ts.tv_sec = 0;
+  ts.tv_nsec = 0;
+
+  if (rate > 0)
+  {
+    ts.tv_sec = frames / rate;
+    ts.tv_nsec = ((frames % rate) * 1000000000ull) / rate;
+  }
+
+  return ts;
+}
+
+MockBackend::MockBackend(snd_pcm_stream_t stream_type, MockBackendConfig config) :
+  stream_direction(stream_type),
+  mock_config(config),
+  pcm_state(SND_PCM_STATE_OPEN),
+  suspended_state(SND_PCM_STATE_OPEN),
+  busy_resume_count(0),
+  suspend_resumable(true),
+  access_type(SND_PCM_ACCESS_RW_INTERLEAVED),
+  format_type(SND_PCM_FORMAT_S16_LE),
+  channels(0),
+  sample_rate_hz(0),
+  sample_bits(0),
+  period_size(0),
+  buffer_size(0),
+  current_sw_params(),
+  hw_position(0),
+  hw_ptr(0),
+  appl_ptr(0),
+  start_position(0),
+  clock_frames(0),
+  trigger_frames(0),
+  avail_max(0),
+  jitter_state(config.jitter_seed != 0 ? config.jitter_seed : 1),
+  stats()
+{
+  if (mock_config.periods < 2 || mock_config.max_channels == 0 || mock_config.min_rate_hz == 0 || mock_config.min_rate_hz > mock_config.max_rate_hz)
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), true, "Invalid mock PCM device configuration.");
+}
+
+void MockBackend::advance(snd_pcm_uframes_t frames)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  advance_clock(frames);
+}
+
+int MockBackend::inject_xrun()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state != SND_PCM_STATE_RUNNING)
+    return -EBADFD;
+
+  pcm_state = SND_PCM_STATE_XRUN;
+  trigger_frames = clock_frames;
+  stats.xruns++;
+
+  return 0;
+}
+
+int MockBackend::inject_suspend(unsigned int busy_resumes, bool resumable)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state != SND_PCM_STATE_PREPARED && pcm_state != SND_PCM_STATE_RUNNING)
+    return -EBADFD;
+
+  suspended_state = pcm_state;
+  pcm_state = SND_PCM_STATE_SUSPENDED;
+  busy_resume_count = busy_resumes;
+  suspend_resumable = resumable;
+  stats.suspends++;
+
+  return 0;
+}
+
+uint64_t MockBackend::get_virtual_time_ns()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  snd_htimestamp_t ts = frames_to_timestamp(clock_frames, sample_rate_hz);
+
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+MockBackendStats MockBackend::get_stats()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  return stats;
+}
+
+void MockBackend::reset_stats()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  stats = MockBackendStats();
+}
+
+std::string MockBackend::get_name()
+{
+  return "mock";
+}
+
+snd_pcm_stream_t MockBackend::get_stream_direction()
+{
+  return stream_direction;
+}
+
+int MockBackend::hw_params(HwConfig& config)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state != SND_PCM_STATE_OPEN && pcm_state != SND_PCM_STATE_SETUP && pcm_state != SND_PCM_STATE_PREPARED)
+    return -EBADFD;
+
+  int width = snd_pcm_format_physical_width(config.format_type);
+
+  if (width <= 0 || width % 8 != 0)
+  {
+    handle_error_code(-EINVAL, false, "Cannot set sample format for PCM object.");
+    return -EINVAL;
+  }
+
+  if (config.channels == 0 || (config.channels > mock_config.max_channels && !config.channels_near))
+  {
+    handle_error_code(-EINVAL, false, "Cannot set channel count for PCM object.");
+    return -EINVAL;
+  }
+
+  config.channels = std::min(config.channels, mock_config.max_channels);
+  config.sample_rate_hz = std::max(mock_config.min_rate_hz, std::min(config.sample_rate_hz, mock_config.max_rate_hz));
+
+  snd_pcm_uframes_t min_size, max_size;
+  period_size_range(min_size, max_size);
+
+  if (config.period_size == 0)
+    config.period_size = (static_cast<uint64_t>(config.sample_rate_hz) * config.period_time_us) / 1000000;
+
+  config.period_size = std::max(min_size, std::min(config.period_size, max_size));
+
+  if (config.periods == 0)
+  {
+    if (config.buffer_time_us > 0)
+    {
+      uint64_t buffer_frames = (static_cast<uint64_t>(config.sample_rate_hz) * config.buffer_time_us) / 1000000;
+      config.periods = static_cast<unsigned int>((buffer_frames + config.period_size / 2) / config.period_size);
+    }
+    else
+    {
+      config.periods = mock_config.periods;
+    }
+  }
+
+  config.periods = std::max(mock_config.min_periods, std::min(config.periods, mock_config.max_periods));
+  config.period_time_us = static_cast<unsigned int>((static_cast<uint64_t>(config.period_size) * 1000000) / config.sample_rate_hz);
+  config.buffer_size = config.period_size * config.periods;
+  config.buffer_time_us = static_cast<unsigned int>((static_cast<uint64_t>(config.buffer_size) * 1000000) / config.sample_rate_hz);
+
+  access_type = config.access_type;
+  format_type = config.format_type;
+  channels = config.channels;
+  sample_rate_hz = config.sample_rate_hz;
+  sample_bits = width;
+  period_size = config.period_size;
+  buffer_size = config.buffer_size;
+
+  device_buffer.assign(buffer_size * channels * (sample_bits / 8), 0);
+  snd_pcm_format_set_silence(format_type, device_buffer.data(), buffer_size * channels);
+
+  //Same layout a driver would expose: one area per channel, addressed in
+  //bits from the start of the buffer.
+  bool interleaved = (access_type == SND_PCM_ACCESS_RW_INTERLEAVED || access_type == SND_PCM_ACCESS_MMAP_INTERLEAVED);
+  device_areas.resize(channels);
+
+  for (unsigned int c = 0; c < channels; c++)
+  {
+    if (interleaved)
+    {
+      device_areas[c].addr = device_buffer.data();
+      device_areas[c].first = c * sample_bits;
+      device_areas[c].step = channels * sample_bits;
+    }
+    else
+    {
+      device_areas[c].addr = device_buffer.data() + (c * buffer_size * (sample_bits / 8));
+      device_areas[c].first = 0;
+      device_areas[c].step = sample_bits;
+    }
+  }
+
+  //alsa-lib's defaults for a freshly configured stream.
+  current_sw_params.start_threshold = 1;
+  current_sw_params.stop_threshold = buffer_size;
+  current_sw_params.avail_min = period_size;
+  current_sw_params.silence_threshold = 0;
+  current_sw_params.silence_size = 0;
+  current_sw_params.period_event = false;
+  current_sw_params.timestamps = false;
+
+  //Like snd_pcm_hw_params, leave the stream prepared.
+  pcm_state = SND_PCM_STATE_PREPARED;
+  hw_position = 0;
+  hw_ptr = 0;
+  appl_ptr = 0;
+  start_position = 0;
+
+  return 0;
+}
+
+int MockBackend::hw_ranges(const HwConfig& config, HwRanges& ranges)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state != SND_PCM_STATE_OPEN && pcm_state != SND_PCM_STATE_SETUP && pcm_state != SND_PCM_STATE_PREPARED)
+    return -EBADFD;
+
+  ranges.sample_rate_hz = std::max(mock_config.min_rate_hz, std::min(config.sample_rate_hz, mock_config.max_rate_hz));
+  period_size_range(ranges.period_size_min, ranges.period_size_max);
+  ranges.periods_min = mock_config.min_periods;
+  ranges.periods_max = mock_config.max_periods;
+  ranges.buffer_size_min = ranges.period_size_min * ranges.periods_min;
+  ranges.buffer_size_max = ranges.period_size_max * ranges.periods_max;
+
+  return 0;
+}
+
+int MockBackend::hw_params_test(const HwConfig& config)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  snd_pcm_uframes_t min_size, max_size;
+  period_size_range(min_size, max_size);
+
+  if (config.period_size < min_size || config.period_size > max_size)
+    return -EINVAL;
+
+  if (config.periods < mock_config.min_periods || config.periods > mock_config.max_periods)
+    return -EINVAL;
+
+  return 0;
+}
+
+int MockBackend::sw_params_current(SwParams& params)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state == SND_PCM_STATE_OPEN)
+    return -EBADFD;
+
+  params = current_sw_params;
+  return 0;
+}
+
+int MockBackend::sw_params(const SwParams& params)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state == SND_PCM_STATE_OPEN)
+    return -EBADFD;
+
+  current_sw_params = params;
+
+  if (current_sw_params.avail_min == 0)
+    current_sw_params.avail_min = 1;
+
+  return 0;
+}
+
+snd_pcm_state_t MockBackend::state()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  return pcm_state;
+}
+
+int MockBackend::prepare()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state == SND_PCM_STATE_OPEN || pcm_state == SND_PCM_STATE_DISCONNECTED)
+    return -EBADFD;
+
+  pcm_state = SND_PCM_STATE_PREPARED;
+  hw_position = 0;
+  hw_ptr = 0;
+  appl_ptr = 0;
+  start_position = 0;
+  trigger_frames = clock_frames;
+  stats.prepares++;
+
+  return 0;
+}
+
+int MockBackend::start()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state != SND_PCM_STATE_PREPARED)
+    return -EBADFD;
+
+  do_start();
+  return 0;
+}
+
+int MockBackend::resume()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state != SND_PCM_STATE_SUSPENDED)
+    return -EBADFD;
+
+  if (busy_resume_count > 0)
+  {
+    busy_resume_count--;
+    return -EAGAIN;
+  }
+
+  if (!suspend_resumable)
+    return -ENOSYS;
+
+  pcm_state = suspended_state;
+  stats.resumes++;
+
+  return 0;
+}
+
+int MockBackend::nonblock(int nonblock)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  mock_config.nonblocking = (nonblock != 0);
+
+  return 0;
+}
+
+bool MockBackend::is_nonblocking()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  return mock_config.nonblocking;
+}
+
+snd_pcm_sframes_t MockBackend::avail_update()
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  int state_err;
+
+  if ((state_err = state_error()) < 0)
+    return state_err;
+
+  return ready_frames();
+}
+
+snd_pcm_sframes_t MockBackend::avail()
+{
+  return avail_update();
+}
+
+int MockBackend::delay(snd_pcm_sframes_t& delay)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  int state_err;
+
+  if ((state_err = state_error()) < 0)
+    return state_err;
+
+  if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+    delay = appl_ptr - hw_position;
+  else
+    delay = hw_position - appl_ptr;
+
+  return 0;
+}
+
+int MockBackend::wait(int timeout_ms)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  int state_err;
+
+  if ((state_err = state_error()) < 0)
+    return state_err;
+
+  int64_t timeout_frames = (timeout_ms < 0) ? -1 : (static_cast<int64_t>(timeout_ms) * sample_rate_hz) / 1000;
+
+  return block_until_ready(std::min(current_sw_params.avail_min, buffer_size), timeout_frames);
+}
+
+int MockBackend::status(PCMStatus& status)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (pcm_state == SND_PCM_STATE_OPEN)
+    return -EBADFD;
+
+  status.state = pcm_state;
+  status.trigger_timestamp = frames_to_timestamp(trigger_frames, sample_rate_hz);
+  status.timestamp = frames_to_timestamp(clock_frames, sample_rate_hz);
+  status.audio_timestamp = frames_to_timestamp(hw_position, sample_rate_hz);
+
+  if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+    status.delay = appl_ptr - hw_position;
+  else
+    status.delay = hw_position - appl_ptr;
+
+  status.avail = ready_frames();
+  status.avail_max = avail_max;
+  status.overrange = 0;
+  avail_max = status.avail;
+
+  return 0;
+}
+
+snd_pcm_sframes_t MockBackend::writei(const void* frames, snd_pcm_uframes_t frame_count)
+{
+  void* buffer = const_cast<void*>(frames);
+  return transfer(&buffer, true, frame_count);
+}
+
+snd_pcm_sframes_t MockBackend::readi(void* frames, snd_pcm_uframes_t frame_count)
+{
+  return transfer(&frames, true, frame_count);
+}
+
+snd_pcm_sframes_t MockBackend::writen(void** channels, snd_pcm_uframes_t frame_count)
+{
+  return transfer(channels, false, frame_count);
+}
+
+snd_pcm_sframes_t MockBackend::readn(void** channels, snd_pcm_uframes_t frame_count)
+{
+  return transfer(channels, false, frame_count);
+}
+
+int MockBackend::mmap_begin(const snd_pcm_channel_area_t** areas, snd_pcm_uframes_t* offset, snd_pcm_uframes_t* frames)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+
+  if (access_type != SND_PCM_ACCESS_MMAP_INTERLEAVED && access_type != SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+    return -EBADFD;
+
+  if (pcm_state == SND_PCM_STATE_OPEN)
+    return -EBADFD;
+
+  snd_pcm_uframes_t position = appl_ptr % buffer_size;
+
+  *areas = device_areas.data();
+  *offset = position;
+  *frames = std::min(std::min(*frames, ready_frames()), buffer_size - position);
+
+  return 0;
+}
+
+snd_pcm_sframes_t MockBackend::mmap_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  int state_err;
+
+  stats.transfer_calls++;
+
+  if ((state_err = state_error()) < 0)
+    return state_err;
+
+  if (offset != appl_ptr % buffer_size || frames > ready_frames())
+    return -EINVAL;
+
+  appl_ptr += frames;
+  stats.frames_transferred += frames;
+
+  if (stream_direction == SND_PCM_STREAM_PLAYBACK && pcm_state == SND_PCM_STATE_PREPARED && appl_ptr - hw_position >= current_sw_params.start_threshold)
+    do_start();
+
+  return frames;
+}
+
+int MockBackend::poll_descriptors_count()
+{
+  return -ENOSYS;
+}
+
+int MockBackend::poll_descriptors(struct pollfd*, unsigned int)
+{
+  return -ENOSYS;
+}
+
+int MockBackend::poll_descriptors_revents(struct pollfd*, unsigned int, unsigned short*)
+{
+  return -ENOSYS;
+}
+
+//Moves virtual time forward. A running stream moves its hardware pointer
+//with it until the stop threshold is reached, at which point it stops with
+//an xrun exactly as the kernel would.
+void MockBackend::advance_clock(uint64_t frames)
+{
+  clock_frames += frames;
+
+  if (pcm_state != SND_PCM_STATE_RUNNING)
+    return;
+
+  uint64_t target = hw_position + frames;
+  bool playback = (stream_direction == SND_PCM_STREAM_PLAYBACK);
+  snd_pcm_uframes_t stop_threshold = current_sw_params.stop_threshold;
+
+  if (stop_threshold <= buffer_size)
+  {
+    //Position at which avail reaches the stop threshold.
+    uint64_t limit;
+
+    if (playback)
+      limit = (appl_ptr + stop_threshold > buffer_size) ? appl_ptr + stop_threshold - buffer_size : 0;
+    else
+      limit = appl_ptr + stop_threshold;
+
+    limit = std::max(limit, hw_position);
+
+    if (target >= limit)
+    {
+      hw_position = limit;
+      hw_ptr = limit;
+      pcm_state = SND_PCM_STATE_XRUN;
+      trigger_frames = clock_frames - (target - limit);
+      stats.xruns++;
+      return;
+    }
+  }
+  else
+  {
+    //Stopping is disabled: playback replays stale data and capture
+    //overwrites what hasn't been read.
+    if (playback && target > appl_ptr)
+      appl_ptr = target;
+    else if (!playback && target - appl_ptr > buffer_size)
+      appl_ptr = target - buffer_size;
+  }
+
+  hw_position = target;
+
+  if (mock_config.period_pointer)
+    hw_ptr = start_position + ((hw_position - start_position) / period_size) * period_size;
+  else
+    hw_ptr = hw_position;
+}
+
+snd_pcm_uframes_t MockBackend::ready_frames()
+{
+  snd_pcm_uframes_t ready;
+
+  if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+    ready = buffer_size - (appl_ptr - hw_ptr);
+  else
+    ready = hw_ptr - appl_ptr;
+
+  if (ready > avail_max)
+    avail_max = ready;
+
+  return ready;
+}
+
+int MockBackend::state_error()
+{
+  switch (pcm_state)
+  {
+    case SND_PCM_STATE_XRUN:
+      return -EPIPE;
+    case SND_PCM_STATE_SUSPENDED:
+      return -ESTRPIPE;
+    case SND_PCM_STATE_OPEN:
+    case SND_PCM_STATE_SETUP:
+    case SND_PCM_STATE_DISCONNECTED:
+      return -EBADFD;
+    default:
+      return 0;
+  }
+}
+
+//Skips virtual time ahead to the moment frames_needed frames are ready,
+//plus any configured wakeup jitter. Returns 1 when ready, 0 on timeout
+//(timeout_frames < 0 waits forever) or a negative error if the stream
+//stopped meanwhile.
+int MockBackend::block_until_ready(snd_pcm_uframes_t frames_needed, int64_t timeout_frames)
+{
+  if (ready_frames() >= frames_needed)
+    return 1;
+
+  stats.waits++;
+
+  if (pcm_state != SND_PCM_STATE_RUNNING)
+  {
+    //Nothing will move the pointer; a real device would block until the
+    //timeout, or forever.
+    if (timeout_frames < 0)
+      return -EIO;
+
+    advance_clock(timeout_frames);
+    stats.wait_frames += timeout_frames;
+    return 0;
+  }
+
+  uint64_t ready_ptr;
+
+  if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+    ready_ptr = appl_ptr + frames_needed - buffer_size;
+  else
+    ready_ptr = appl_ptr + frames_needed;
+
+  if (mock_config.period_pointer)
+    ready_ptr = start_position + ((ready_ptr - start_position + period_size - 1) / period_size) * period_size;
+
+  uint64_t frames = (ready_ptr - hw_position) + next_jitter_frames();
+
+  if (timeout_frames >= 0 && frames > static_cast<uint64_t>(timeout_frames))
+  {
+    advance_clock(timeout_frames);
+    stats.wait_frames += timeout_frames;
+
+    int state_err = state_error();
+    return (state_err < 0) ? state_err : 0;
+  }
+
+  advance_clock(frames);
+  stats.wait_frames += frames;
+
+  int state_err = state_error();
+  return (state_err < 0) ? state_err : 1;
+}
+
+void MockBackend::period_size_range(snd_pcm_uframes_t& min_size, snd_pcm_uframes_t& max_size)
+{
+  if (mock_config.period_size > 0)
+  {
+    min_size = max_size = mock_config.period_size;
+    return;
+  }
+
+  min_size = std::max<snd_pcm_uframes_t>(1, mock_config.min_period_size);
+  max_size = std::max(min_size, mock_config.max_period_size);
+}
+
+void MockBackend::do_start()
+{
+  pcm_state = SND_PCM_STATE_RUNNING;
+  start_position = hw_position;
+  trigger_frames = clock_frames;
+  stats.starts++;
+}
+
+//Read/write with alsa-lib's semantics: copy whatever fits, wait for
+//avail_min when more is left, return a short count if the stream stops
+//part way and the error if it stopped before anything was transferred.
+//Non-blocking, it returns what fitted straight away, or -EAGAIN if nothing.
+snd_pcm_sframes_t MockBackend::transfer(void* const* buffers, bool interleaved, snd_pcm_uframes_t frame_count)
+{
+  std::lock_guard<std::mutex> lock(device_mutex);
+  bool playback = (stream_direction == SND_PCM_STREAM_PLAYBACK);
+  snd_pcm_access_t expected_access = interleaved ? SND_PCM_ACCESS_RW_INTERLEAVED : SND_PCM_ACCESS_RW_NONINTERLEAVED;
+
+  if (access_type != expected_access)
+    return -EINVAL;
+
+  stats.transfer_calls++;
+
+  snd_pcm_uframes_t frames_done = 0;
+  snd_pcm_uframes_t avail_min = std::min(current_sw_params.avail_min, buffer_size);
+
+  while (frames_done < frame_count)
+  {
+    int state_err;
+
+    if ((state_err = state_error()) < 0)
+      return (frames_done > 0) ? static_cast<snd_pcm_sframes_t>(frames_done) : state_err;
+
+    if (!playback && pcm_state == SND_PCM_STATE_PREPARED)
+      do_start();
+
+    snd_pcm_uframes_t remaining = frame_count - frames_done;
+    snd_pcm_uframes_t ready = ready_frames();
+
+    if (ready == 0 && pcm_state == SND_PCM_STATE_PREPARED)
+    {
+      do_start(); //Buffer full before the start threshold was reached.
+      continue;
+    }
+
+    if (ready == 0 && mock_config.nonblocking)
+      return (frames_done > 0) ? static_cast<snd_pcm_sframes_t>(frames_done) : -EAGAIN;
+
+    if (ready < remaining && ready < avail_min && pcm_state == SND_PCM_STATE_RUNNING && !mock_config.nonblocking)
+    {
+      if ((state_err = block_until_ready(avail_min, -1)) < 0)
+        return (frames_done > 0) ? static_cast<snd_pcm_sframes_t>(frames_done) : state_err;
+
+      continue;
+    }
+
+    snd_pcm_uframes_t frames = std::min(ready, remaining);
+    snd_pcm_uframes_t position = appl_ptr % buffer_size;
+    snd_pcm_uframes_t first_part = std::min(frames, buffer_size - position);
+
+    copy_frames(buffers, interleaved, position, frames_done, first_part);
+
+    if (first_part < frames)
+      copy_frames(buffers, interleaved, 0, frames_done + first_part, frames - first_part);
+
+    appl_ptr += frames;
+    frames_done += frames;
+    stats.frames_transferred += frames;
+
+    if (playback && pcm_state == SND_PCM_STATE_PREPARED && appl_ptr - hw_position >= current_sw_params.start_threshold)
+      do_start();
+  }
+
+  return frames_done;
+}
+
+void MockBackend::copy_frames(void* const* buffers, bool interleaved, snd_pcm_uframes_t device_offset, snd_pcm_uframes_t user_offset, snd_pcm_uframes_t frames)
+{
+  bool playback = (stream_direction == SND_PCM_STREAM_PLAYBACK);
+  size_t sample_size = sample_bits / 8;
+
+  if (interleaved)
+  {
+    size_t frame_size = sample_size * channels;
+    char* device_data = device_buffer.data() + (device_offset * frame_size);
+    char* user_data = static_cast<char*>(buffers[0]) + (user_offset * frame_size);
+
+    if (playback)
+      memcpy(device_data, user_data, frames * frame_size);
+    else
+      memcpy(user_data, device_data, frames * frame_size);
+  }
+  else
+  {
+    for (unsigned int c = 0; c < channels; c++)
+    {
+      char* device_data = static_cast<char*>(device_areas[c].addr) + (device_offset * sample_size);
+      char* user_data = static_cast<char*>(buffers[c]) + (user_offset * sample_size);
+
+      if (playback)
+        memcpy(device_data, user_data, frames * sample_size);
+      else
+        memcpy(user_data, device_data, frames * sample_size);
+    }
+  }
+}
+
+//Wakeup lateness in frames, from a fixed-seed xorshift so runs repeat.
+uint32_t MockBackend::next_jitter_frames()
+{
+  uint32_t max_jitter = static_cast<uint32_t>((static_cast<uint64_t>(mock_config.wakeup_jitter_us) * sample_rate_hz) / 1000000);
+
+  if (max_jitter == 0)
+    return 0;
+
+  jitter_state ^= jitter_state << 13;
+  jitter_state ^= jitter_state >> 17;
+  jitter_state ^= jitter_state << 5;
+
+  return jitter_state % (max_jitter + 1);
+}
@@ -1,161 +1,1273 @@
 #include <alsaplusplus/pcm.hpp>
 
+#include <cstdio>
+
 using namespace AlsaPlusPlus;
 
-PCMDevice::PCMDevice(std::string hw_device, snd_pcm_stream_t stream_type) :
+//Longest a render thread blocks on the device before re-checking whether it
+//has been asked to stop.
+constexpr int RENDER_WAIT_TIMEOUT_MS = 100;
+
+//mode takes snd_pcm_open flags. With SND_PCM_NONBLOCK transfers return
+//whatever fit instead of blocking (-EAGAIN if nothing did); wait_ready
+//sleeps until the device can take more.
+PCMDevice::PCMDevice(std::string hw_device, snd_pcm_stream_t stream_type, int mode) :
+  PCMDevice(std::unique_ptr<PCMBackend>(new AlsaBackend(hw_device, stream_type, mode)))
+{
+}
+
+//Drives whatever device pcm_backend wraps - a MockBackend for profiling
+//without hardware, or an AlsaBackend opened with non-default flags.
+PCMDevice::PCMDevice(std::unique_ptr<PCMBackend> pcm_backend) :
   err(0),
-  device_name(hw_device),
-  hw_params_alloc(false)
+  device_name(pcm_backend->get_name()),
+  stream_direction(pcm_backend->get_stream_direction()),
+  backend(std::move(pcm_backend)),
+  nonblocking(backend->is_nonblocking()),
+  transfer_would_block(false),
+  frame_size(0),
+  period_size(0),
+  buffer_size(0),
+  silence_frames(0),
+  suspended(false),
+  underrun_count(0),
+  overrun_count(0),
+  suspend_count(0),
+  failed_recovery_count(0),
+  stream_rate_hz(0),
+  stream_channels(AudioChannels::MONO),
+  channel_mixing_active(false)
+{
+  start_error_drain();
+}
+
+int PCMDevice::set_hardware_params(HwParams params)
 {
-  if ((err = snd_pcm_open(&pcm_handle, device_name.c_str(), stream_type, 0)) < 0)
-    handle_error_code(err, true, "Cannot open handle to PCM audio device.");
+  return apply_hardware_params(params, 0);
 }
 
-PCMDevice::~PCMDevice()
+//Configures the device for target latency instead of a fixed period time:
+//the buffer layouts params' access, format, channels and rate leave open
+//are ranked by rank_buffer_layouts and the first one the device accepts is
+//applied. period_time_us, periods and buffer_time_us in params are ignored
+//on the way in; on success params holds the negotiated configuration, as
+//get_hardware_params would return it.
+int PCMDevice::configure_latency(HwParams& params, const LatencyTarget& target)
 {
-  if (hw_params_alloc)
-    snd_pcm_hw_params_free(hw_params);
+  snd_pcm_state_t hw_state = backend->state();
+
+  if (hw_state != SND_PCM_STATE_OPEN)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not configure PCM device - device is not in SND_PCM_STATE_OPEN.", snd_pcm_state_name(hw_state));
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  HwConfig config;
+  config.access_type = params.access_type;
+  config.format_type = params.format_type;
+  config.channels = static_cast<int>(params.channels);
+  config.channels_near = (stream_direction == SND_PCM_STREAM_PLAYBACK && params.channel_mixing);
+  config.sample_rate_hz = params.sample_rate_hz;
+  config.period_time_us = 0;
+  config.period_size = 0;
+  config.periods = 0;
+  config.buffer_time_us = 0;
+
+  HwRanges ranges;
+
+  if ((err = backend->hw_ranges(config, ranges)) < 0)
+    return err;
+
+  for (const BufferLayout& layout : rank_buffer_layouts(ranges, target))
+  {
+    config.period_size = layout.period_size;
+    config.periods = layout.periods;
+
+    if (backend->hw_params_test(config) < 0)
+      continue;
+
+    params.periods = layout.periods;
+    params.buffer_time_us = 0;
+
+    if ((err = apply_hardware_params(params, layout.period_size)) < 0)
+      return err;
+
+    params = input_params;
+    return 0;
+  }
 
-  snd_pcm_close(pcm_handle);
+  handle_error_code(-static_cast<int>(std::errc::invalid_argument), false, "No buffer layout of the PCM device meets the latency target.");
+  return -static_cast<int>(std::errc::invalid_argument);
 }
 
-int PCMDevice::set_hardware_params(HwParams params)
+//period_frames, when nonzero, sets the period size in frames in place of
+//params.period_time_us, so a layout picked in frames isn't rounded twice.
+int PCMDevice::apply_hardware_params(HwParams params, snd_pcm_uframes_t period_frames)
 {
-  snd_pcm_state_t hw_state = snd_pcm_state(pcm_handle);
+  snd_pcm_state_t hw_state = backend->state();
 
   if (hw_state == SND_PCM_STATE_OPEN)
   {
     input_params = params;
-    frame_size = snd_pcm_format_physical_width(input_params.format_type) * static_cast<int>(input_params.channels);
+    stream_channels = input_params.channels;
 
-    if ((err = snd_pcm_hw_params_malloc(&hw_params)) < 0)
-    {
-      handle_error_code(err, false, "Cannot allocate hardware parameter structure for PCM object.");
+    HwConfig config;
+    config.access_type = input_params.access_type;
+    config.format_type = input_params.format_type;
+    config.channels = static_cast<int>(input_params.channels);
+    //Playback can remix in write_float, so take whatever the device offers.
+    config.channels_near = (stream_direction == SND_PCM_STREAM_PLAYBACK && input_params.channel_mixing);
+    config.sample_rate_hz = input_params.sample_rate_hz;
+    config.period_time_us = input_params.period_time_us;
+    config.period_size = period_frames;
+    config.periods = input_params.periods;
+    config.buffer_time_us = input_params.buffer_time_us;
+
+    if ((err = backend->hw_params(config)) < 0)
       return err;
+
+    if (config.channels != static_cast<unsigned int>(input_params.channels))
+    {
+      if (config.channels > ChannelMatrix::MAX_CHANNELS)
+      {
+        handle_error_code(-static_cast<int>(std::errc::invalid_argument), false, "Cannot set channel count for PCM object.");
+        return -static_cast<int>(std::errc::invalid_argument);
+      }
+
+      //Only reachable with channel_mixing set; get_hardware_params reports
+      //the device's count and get_stream_channels the requested one.
+      input_params.channels = static_cast<AudioChannels>(config.channels);
     }
+
+    frame_size = (snd_pcm_format_physical_width(input_params.format_type) / 8) * config.channels;
+
+    stream_rate_hz = input_params.sample_rate_hz;
+    input_params.sample_rate_hz = config.sample_rate_hz;
+    input_params.period_time_us = config.period_time_us;
+    input_params.periods = config.periods;
+    input_params.buffer_time_us = config.buffer_time_us;
+    period_size = config.period_size;
+    buffer_size = config.buffer_size;
+
+    channel_positions.assign(static_cast<int>(input_params.channels), nullptr);
+    conversion_buffer.resize(period_size * frame_size);
+    prepare_silence_buffer();
+
+    channel_mixing_active = (stream_channels != input_params.channels);
+
+    if (channel_mixing_active)
+    {
+      channel_matrix = ChannelMatrix::preset(stream_channels, input_params.channels);
+      mix_buffer.resize(period_size * static_cast<int>(input_params.channels));
+    }
+
+    if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+      gain_buffer.resize(period_size * static_cast<int>(input_params.channels));
+
+    //Playback at a rate the device doesn't offer is converted in software
+    //by write_float, one period at a time, instead of playing at the wrong pitch.
+    if (stream_direction == SND_PCM_STREAM_PLAYBACK && stream_rate_hz != input_params.sample_rate_hz)
+    {
+      if ((err = resampler.configure(stream_rate_hz, input_params.sample_rate_hz, static_cast<int>(input_params.channels), input_params.resampler_quality, period_size)) < 0)
+        return err;
+
+      if (resampler.active())
+        resample_buffer.resize(resampler.max_output_frames(period_size) * static_cast<int>(input_params.channels));
+    }
+
+    //Without the resampler (capture, or a rate it can't convert) the caller
+    //gets frames at the device rate.
+    if (stream_rate_hz != input_params.sample_rate_hz && !resampler.active())
+    {
+      char rates[64];
+      snprintf(rates, sizeof(rates), "requested %u Hz, got %u Hz", stream_rate_hz, input_params.sample_rate_hz);
+      handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Selected sample rate does not match requested.", rates);
+    }
+  }
+  else
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not configure PCM device - device is not in SND_PCM_STATE_OPEN.", snd_pcm_state_name(hw_state));
+  }
+
+  return 0;
+}
+
+int PCMDevice::get_software_params(SwParams& params)
+{
+  if ((err = backend->sw_params_current(params)) < 0)
+    return err;
+
+  return 0;
+}
+
+int PCMDevice::set_software_params(SwParams params)
+{
+  snd_pcm_state_t hw_state = backend->state();
+
+  if (hw_state != SND_PCM_STATE_SETUP && hw_state != SND_PCM_STATE_PREPARED)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not configure PCM software parameters - device is not in SND_PCM_STATE_SETUP or SND_PCM_STATE_PREPARED.", snd_pcm_state_name(hw_state));
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  if ((err = backend->sw_params(params)) < 0)
+    return err;
+
+  return 0;
+}
+
+//Recovers from error_code, as returned by a transfer or wait. Never sleeps:
+//a suspend that has not been released after xrun_policy.resume_attempts tries
+//returns -EAGAIN so the caller can retry on its next call. Works on locals
+//only, since the render thread recovers while other threads query the device.
+int PCMDevice::xrun_recovery(int error_code)
+{
+  int recover_err = error_code;
+
+  if (error_code == -EPIPE)
+  {
+    if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+      underrun_count++;
     else
+      overrun_count++;
+
+    if ((recover_err = backend->prepare()) < 0)
     {
-      hw_params_alloc = true;
+      failed_recovery_count++;
+      handle_error_code(recover_err, false, "Attempt to recover from xrun failed.");
+      return recover_err;
     }
 
-    if ((err = snd_pcm_hw_params_any(pcm_handle, hw_params)) < 0)
+    prefill_silence();
+    return 0;
+  }
+  else if (error_code == -ESTRPIPE)
+  {
+    if (!suspended)
     {
-      handle_error_code(err, false, "Cannot initialize hardware parameter structure for PCM object.");
-      return err;
+      suspend_count++;
+      suspended = true;
     }
 
-    if ((err = snd_pcm_hw_params_set_access(pcm_handle, hw_params, input_params.access_type)) < 0)
+    for (unsigned int attempt = 0; attempt < xrun_policy.resume_attempts; attempt++)
     {
-      handle_error_code(err, false, "Cannot set access type for PCM object.");
-      return err;
+      if ((recover_err = backend->resume()) != -EAGAIN)
+        break;
     }
 
-    if ((err = snd_pcm_hw_params_set_format(pcm_handle, hw_params, input_params.format_type)) < 0)
+    if (recover_err == -EAGAIN)
+      return recover_err; //Suspend not released yet.
+
+    suspended = false;
+
+    if (recover_err < 0)
     {
-      handle_error_code(err, false, "Cannot set sample format for PCM object.");
-      return err;
+      if ((recover_err = backend->prepare()) < 0)
+      {
+        failed_recovery_count++;
+        handle_error_code(recover_err, false, "Cannot recover from suspend.");
+        return recover_err;
+      }
+
+      prefill_silence();
     }
 
-    if ((err = snd_pcm_hw_params_set_channels(pcm_handle, hw_params, static_cast<int>(input_params.channels))) < 0)
+    return 0;
+  }
+
+  return error_code;
+}
+
+//Runs xrun_recovery for error_code and tells a transfer loop what to do
+//next: 0 = carry on from the current position, 1 = end this transfer early
+//(frames dropped per policy, or the device can't take more yet), negative =
+//unrecoverable. When the device can't take more yet transfer_would_block is
+//set, so the transfer reports only the frames it moved - or -EAGAIN - rather
+//than counting the remainder as dropped.
+int PCMDevice::handle_xrun(int error_code, const char* error_desc)
+{
+  int xrun_err;
+
+  //A non-blocking device with no room (or nothing captured) ends the
+  //transfer early; the caller waits with wait_ready and resubmits the rest.
+  if (error_code == -EAGAIN)
+  {
+    transfer_would_block = true;
+    return 1;
+  }
+
+  if ((xrun_err = xrun_recovery(error_code)) < 0)
+  {
+    if (xrun_err == -EAGAIN)
     {
-      handle_error_code(err, false, "Cannot set channel count for PCM object.");
-      return err;
+      transfer_would_block = true; //Still suspended - nothing was dropped.
+      return 1;
     }
 
-    unsigned int req_rate = input_params.sample_rate_hz;
+    handle_error_code(xrun_err, false, error_desc);
+    return xrun_err;
+  }
+
+  return (xrun_policy.action == XrunAction::DROP) ? 1 : 0;
+}
+
+//Queues silence after a playback underrun so the restarted stream has
+//headroom instead of underrunning again on the next period.
+void PCMDevice::prefill_silence()
+{
+  if (stream_direction != SND_PCM_STREAM_PLAYBACK || silence_frames == 0)
+    return;
+
+  if (input_params.access_type == SND_PCM_ACCESS_MMAP_INTERLEAVED || input_params.access_type == SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+  {
+    MmapArea area;
+    area.frames = silence_frames;
+
+    if (backend->mmap_begin(&area.areas, &area.offset, &area.frames) < 0)
+      return;
+
+    snd_pcm_areas_silence(area.areas, area.offset, static_cast<int>(input_params.channels), area.frames, input_params.format_type);
+    backend->mmap_commit(area.offset, area.frames);
+  }
+  else if (input_params.access_type == SND_PCM_ACCESS_RW_INTERLEAVED)
+  {
+    backend->writei(silence_buffer.data(), silence_frames);
+  }
+  else
+  {
+    //Every channel can share the buffer; it holds at least a channel's worth.
+    for (size_t c = 0; c < channel_positions.size(); c++)
+      channel_positions[c] = silence_buffer.data();
 
-    if ((err = snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &req_rate, 0)) < 0)
+    backend->writen(channel_positions.data(), silence_frames);
+  }
+}
+
+//Sizes the silence buffer for the current policy and stream format.
+void PCMDevice::prepare_silence_buffer()
+{
+  silence_frames = xrun_policy.silence_prefill_frames;
+
+  if (silence_frames > buffer_size)
+    silence_frames = buffer_size;
+
+  silence_buffer.resize(silence_frames * frame_size);
+
+  if (silence_frames > 0)
+    snd_pcm_format_set_silence(input_params.format_type, silence_buffer.data(), silence_frames * static_cast<int>(input_params.channels));
+}
+
+void PCMDevice::set_xrun_policy(XrunPolicy policy)
+{
+  xrun_policy = policy;
+  prepare_silence_buffer();
+}
+
+XrunPolicy PCMDevice::get_xrun_policy()
+{
+  return xrun_policy;
+}
+
+XrunStats PCMDevice::get_xrun_stats()
+{
+  XrunStats stats;
+  stats.underruns = underrun_count;
+  stats.overruns = overrun_count;
+  stats.suspends = suspend_count;
+  stats.failed_recoveries = failed_recovery_count;
+
+  return stats;
+}
+
+void PCMDevice::reset_xrun_stats()
+{
+  underrun_count = 0;
+  overrun_count = 0;
+  suspend_count = 0;
+  failed_recovery_count = 0;
+}
+
+//Moves frame_count interleaved frames between the caller's buffer and the
+//device - writei/readi for RW access, the DMA area for MMAP access.
+snd_pcm_sframes_t PCMDevice::transfer_interleaved(void* frames, snd_pcm_uframes_t frame_count)
+{
+  if (input_params.access_type == SND_PCM_ACCESS_MMAP_INTERLEAVED)
+    return mmap_transfer(&frames, frame_count);
+
+  char* data = static_cast<char*>(frames);
+  snd_pcm_uframes_t frames_done = 0;
+  transfer_would_block = false;
+
+  while (frames_done < frame_count)
+  {
+    snd_pcm_sframes_t transferred;
+
+    if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+      transferred = backend->writei(data + (frames_done * frame_size), frame_count - frames_done);
+    else
+      transferred = backend->readi(data + (frames_done * frame_size), frame_count - frames_done);
+
+    if (transferred < 0)
     {
-      handle_error_code(err, false, "Cannot set sample rate for PCM object.");
-      return err;
+      int next_step = handle_xrun(transferred, (stream_direction == SND_PCM_STREAM_PLAYBACK) ? "Write error." : "Read error.");
+
+      if (next_step < 0)
+        return next_step;
+
+      if (next_step > 0)
+        break;
+
+      continue; //Restart at the current position.
     }
+
+    frames_done += transferred;
+  }
+
+  return transfer_result(frames_done);
+}
+
+snd_pcm_sframes_t PCMDevice::transfer_noninterleaved(void* const* channels, snd_pcm_uframes_t frame_count)
+{
+  if (input_params.access_type == SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+    return mmap_transfer(channels, frame_count);
+
+  size_t sample_size = frame_size / static_cast<int>(input_params.channels);
+  snd_pcm_uframes_t frames_done = 0;
+  transfer_would_block = false;
+
+  while (frames_done < frame_count)
+  {
+    //snd_pcm_writen/readn want the current position in every channel; reuse
+    //the pointer table sized in set_hardware_params.
+    for (size_t c = 0; c < channel_positions.size(); c++)
+      channel_positions[c] = static_cast<char*>(channels[c]) + (frames_done * sample_size);
+
+    snd_pcm_sframes_t transferred;
+
+    if (stream_direction == SND_PCM_STREAM_PLAYBACK)
+      transferred = backend->writen(channel_positions.data(), frame_count - frames_done);
     else
+      transferred = backend->readn(channel_positions.data(), frame_count - frames_done);
+
+    if (transferred < 0)
     {
-      if (req_rate != input_params.sample_rate_hz)
-      {
-        std::cout << "WARNING: Selected sample rate does not match requested. Requested: " << req_rate << "Hz, got ";
-        std::cout << input_params.sample_rate_hz << "Hz." << std::endl;
-      }
+      int next_step = handle_xrun(transferred, (stream_direction == SND_PCM_STREAM_PLAYBACK) ? "Write error." : "Read error.");
+
+      if (next_step < 0)
+        return next_step;
 
-      input_params.sample_rate_hz = req_rate;
+      if (next_step > 0)
+        break;
+
+      continue; //Restart at the current position.
     }
 
-    if ((err = snd_pcm_hw_params_set_period_time_near(pcm_handle, hw_params, &input_params.period_time_us, 0)) < 0)
+    frames_done += transferred;
+  }
+
+  return transfer_result(frames_done);
+}
+
+//Copies straight to or from the DMA area instead of going through the
+//read/write calls, following the direct loop from alsa-lib's test/pcm.c.
+//With interleaved access buffers[0] holds whole frames, otherwise buffers
+//holds one pointer per channel.
+snd_pcm_sframes_t PCMDevice::mmap_transfer(void* const* buffers, snd_pcm_uframes_t frame_count)
+{
+  bool interleaved = (input_params.access_type == SND_PCM_ACCESS_MMAP_INTERLEAVED);
+  bool playback = (stream_direction == SND_PCM_STREAM_PLAYBACK);
+  int channels = interleaved ? 1 : static_cast<int>(input_params.channels);
+  size_t copy_size = frame_size / channels; //a whole frame, or one channel's sample
+
+  return mmap_loop(frame_count, [buffers, playback, channels, copy_size](const MmapArea& area, snd_pcm_uframes_t frames_done)
+  {
+    for (int c = 0; c < channels; c++)
     {
-      handle_error_code(err, false, "Cannot set period time for PCM object.");
-      return err;
+      char* user_data = static_cast<char*>(buffers[c]) + (frames_done * copy_size);
+
+      if (playback)
+        memcpy(area.channel_data(c), user_data, area.frames * copy_size);
+      else
+        memcpy(user_data, area.channel_data(c), area.frames * copy_size);
     }
 
-    snd_pcm_uframes_t psize;
+    return 0;
+  });
+}
+
+//Blocks until at least frames_needed frames can be mapped, starting the
+//stream if it is still prepared - MMAP transfers never trigger a start on
+//their own. A non-blocking device returns -EAGAIN instead of waiting.
+int PCMDevice::wait_for_mmap_frames(snd_pcm_uframes_t frames_needed)
+{
+  while (true)
+  {
+    snd_pcm_sframes_t avail = backend->avail_update();
+
+    if (avail < 0)
+      return avail;
 
-    if ((err = snd_pcm_hw_params_get_period_size(hw_params, &psize, 0)) < 0)
+    if (static_cast<snd_pcm_uframes_t>(avail) >= frames_needed)
+      return 0;
+
+    if (backend->state() == SND_PCM_STATE_PREPARED)
     {
-      handle_error_code(err, false, "Could not get period size for PCM object.");
-      return err;
+      int start_err;
+
+      if ((start_err = backend->start()) < 0)
+        return start_err;
+    }
+    else if (nonblocking)
+    {
+      return -EAGAIN;
     }
     else
     {
-      period_size = psize;
+      int wait_err;
+
+      if ((wait_err = backend->wait(-1)) < 0)
+        return wait_err;
     }
+  }
+}
+
+//What a transfer loop hands back: the frames moved, or -EAGAIN when a
+//non-blocking device took none at all.
+snd_pcm_sframes_t PCMDevice::transfer_result(snd_pcm_uframes_t frames_done)
+{
+  if (frames_done == 0 && transfer_would_block)
+    return -EAGAIN;
+
+  return frames_done;
+}
+
+//Sleeps until the device can take (playback) or deliver (capture) at least
+//avail_min frames, for at most timeout_ms (negative waits indefinitely).
+//Returns 1 when ready, 0 on timeout, or a negative error code. An xrun or
+//suspend found while waiting is recovered, so the next transfer can go
+//straight ahead; -EAGAIN means the device is still suspended.
+int PCMDevice::wait_ready(int timeout_ms)
+{
+  snd_pcm_sframes_t avail = backend->avail_update();
 
-    if ((err = snd_pcm_hw_params(pcm_handle, hw_params)) < 0)
+  //A prepared stream never signals readiness by itself once it is full
+  //(playback) or because it hasn't started (capture).
+  if (avail >= 0 && backend->state() == SND_PCM_STATE_PREPARED && (stream_direction == SND_PCM_STREAM_CAPTURE || avail == 0))
+  {
+    if ((err = backend->start()) < 0)
     {
-      handle_error_code(err, false, "Cannot apply hardware parameters to PCM device.");
+      handle_error_code(err, false, "Cannot start PCM device.");
       return err;
     }
+  }
+
+  if ((err = backend->wait(timeout_ms)) < 0)
+  {
+    int xrun_err;
+
+    if ((xrun_err = xrun_recovery(err)) < 0)
+    {
+      if (xrun_err != -EAGAIN)
+        handle_error_code(xrun_err, false, "Cannot wait for PCM device.");
+
+      return xrun_err;
+    }
 
-    snd_pcm_hw_params_free(hw_params);
-    hw_params_alloc = false;
+    return 1;
   }
-  else
+
+  return err;
+}
+
+//Switches between blocking and non-blocking transfers on an open device.
+int PCMDevice::set_nonblocking(bool enabled)
+{
+  if ((err = backend->nonblock(enabled ? 1 : 0)) < 0)
   {
-    std::ostringstream oss;
-    oss << "Could not configure PCM device - device in state " << snd_pcm_state_name(hw_state) << " instead of SND_PCM_STATE_OPEN.";
-    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, oss.str());
+    handle_error_code(err, false, "Cannot change blocking mode of PCM device.");
+    return err;
   }
 
+  nonblocking = enabled;
   return 0;
 }
 
-int PCMDevice::xrun_recovery()
+bool PCMDevice::is_nonblocking()
 {
-  if (err == -EPIPE)
+  return nonblocking;
+}
+
+void* MmapArea::channel_data(unsigned int channel) const
+{
+  return static_cast<char*>(areas[channel].addr) + ((areas[channel].first + offset * areas[channel].step) / 8);
+}
+
+//Maps up to the requested number of frames of the device buffer - free
+//space for playback, captured audio for capture. The returned count may be
+//smaller when the mapping wraps the ring buffer end.
+snd_pcm_sframes_t PCMDevice::mmap_begin(MmapArea& area, snd_pcm_uframes_t frames)
+{
+  if (input_params.access_type != SND_PCM_ACCESS_MMAP_INTERLEAVED && input_params.access_type != SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
   {
-    err = snd_pcm_prepare(pcm_handle);
+    handle_error_code(static_cast<int>(std::errc::operation_not_supported), false, "PCM device was not configured for MMAP access.");
+    return -static_cast<int>(std::errc::operation_not_supported);
+  }
+
+  if ((err = wait_for_mmap_frames(frames < period_size ? frames : period_size)) < 0)
+  {
+    int xrun_err;
 
-    if (err < 0)
+    if ((xrun_err = xrun_recovery(err)) < 0)
     {
-      handle_error_code(err, false, "Attempt to recover from underrun failed.");
-      return 0;
+      if (xrun_err != -EAGAIN)
+        handle_error_code(xrun_err, false, "Cannot wait for PCM buffer.");
+
+      return xrun_err;
     }
+
+    if ((err = wait_for_mmap_frames(frames < period_size ? frames : period_size)) < 0)
+      return err;
+  }
+
+  area.frames = frames;
+
+  if ((err = backend->mmap_begin(&area.areas, &area.offset, &area.frames)) < 0)
+  {
+    handle_error_code(err, false, "Cannot map PCM buffer.");
+    return err;
   }
-  else if (err == -ESTRPIPE)
+
+  return area.frames;
+}
+
+snd_pcm_sframes_t PCMDevice::mmap_commit(const MmapArea& area, snd_pcm_uframes_t frames)
+{
+  snd_pcm_sframes_t committed = backend->mmap_commit(area.offset, frames);
+
+  if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != frames)
   {
-    while ((err = snd_pcm_resume(pcm_handle)) == -EAGAIN)
-      sleep(1); //Try once a second until suspend is released.
+    int xrun_err;
 
-    if (err < 0)
+    if ((xrun_err = xrun_recovery(committed >= 0 ? -EPIPE : committed)) < 0)
     {
-      err = snd_pcm_prepare(pcm_handle);
+      if (xrun_err != -EAGAIN)
+        handle_error_code(xrun_err, false, "Cannot commit PCM buffer.");
 
-      if (err < 0)
-      {
-        handle_error_code(err, false, "Cannot recover from suspend during read.");
-      }
+      return xrun_err;
     }
 
     return 0;
   }
 
+  return committed;
+}
+
+int PCMDevice::start()
+{
+  int start_err;
+
+  if ((start_err = backend->start()) < 0)
+    handle_error_code(start_err, false, "Cannot start PCM device.");
+
+  return start_err;
+}
+
+//Runs the xrun/suspend recovery for an error returned by one of the
+//non-transferring calls (avail_update, poll_revents, ...).
+int PCMDevice::recover(int error_code)
+{
+  return xrun_recovery(error_code);
+}
+
+snd_pcm_stream_t PCMDevice::get_stream_direction()
+{
+  return stream_direction;
+}
+
+snd_pcm_sframes_t PCMDevice::avail_update()
+{
+  return backend->avail_update();
+}
+
+int PCMDevice::poll_descriptors(std::vector<struct pollfd>& fds)
+{
+  int count = backend->poll_descriptors_count();
+
+  if (count <= 0)
+  {
+    handle_error_code(count, false, "Cannot get poll descriptor count for PCM device.");
+    return count < 0 ? count : -EINVAL;
+  }
+
+  fds.resize(count);
+
+  if ((err = backend->poll_descriptors(fds.data(), count)) < 0)
+  {
+    handle_error_code(err, false, "Cannot get poll descriptors for PCM device.");
+    return err;
+  }
+
+  return err;
+}
+
+//Translates raw revents from the device's descriptors into POLLIN/POLLOUT
+//for the stream - the descriptors may belong to a plugin chain and need not
+//report readiness directly.
+int PCMDevice::poll_revents(struct pollfd* fds, unsigned int count, unsigned short& revents)
+{
+  if ((err = backend->poll_descriptors_revents(fds, count, &revents)) < 0)
+    handle_error_code(err, false, "Cannot demangle poll events for PCM device.");
+
   return err;
 }
 
-PCMPlayer::PCMPlayer(std::string hw_device) :
-  PCMDevice(hw_device, SND_PCM_STREAM_PLAYBACK)
+unsigned long PCMDevice::get_frame_size()
+{
+  return frame_size;
+}
+
+snd_pcm_uframes_t PCMDevice::get_period_size()
+{
+  return period_size;
+}
+
+//Moves up to max_frames through the two ring regions directly, so the ring
+//storage is the only staging buffer between producer and device.
+snd_pcm_sframes_t PCMDevice::transfer_ring_regions(RingRegion* regions, snd_pcm_uframes_t max_frames)
+{
+  if (input_params.access_type != SND_PCM_ACCESS_RW_INTERLEAVED && input_params.access_type != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Ring buffer transfers require interleaved access.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  snd_pcm_uframes_t frames_done = 0;
+
+  for (int r = 0; r < 2 && frames_done < max_frames; r++)
+  {
+    snd_pcm_uframes_t chunk = regions[r].frames;
+
+    if (chunk > max_frames - frames_done)
+      chunk = max_frames - frames_done;
+
+    if (chunk == 0)
+      break;
+
+    snd_pcm_sframes_t moved = transfer_interleaved(regions[r].data, chunk);
+
+    if (moved < 0)
+      return (frames_done > 0) ? static_cast<snd_pcm_sframes_t>(frames_done) : moved;
+
+    frames_done += moved;
+
+    if (static_cast<snd_pcm_uframes_t>(moved) < chunk)
+      break; //xrun recovered mid-transfer; leave the rest queued.
+  }
+
+  return frames_done;
+}
+
+snd_pcm_uframes_t PCMDevice::get_buffer_size()
+{
+  return buffer_size;
+}
+
+//Rate write_float expects samples at: the requested rate, which is also the
+//device rate unless a resampler was inserted.
+unsigned int PCMDevice::get_stream_rate()
+{
+  return stream_rate_hz;
+}
+
+//Channel count write_float expects frames in: the requested count, which is
+//also the device's unless a channel mix was inserted.
+AudioChannels PCMDevice::get_stream_channels()
+{
+  return stream_channels;
+}
+
+//The parameters as negotiated with the device; sample rate, channels and
+//the buffer layout may differ from what was requested.
+HwParams PCMDevice::get_hardware_params()
+{
+  return input_params;
+}
+
+//Frames between the application pointer and what is audible (playback) or
+//was captured (capture) right now.
+int PCMDevice::get_delay(snd_pcm_sframes_t& delay)
+{
+  if ((err = backend->delay(delay)) < 0)
+    handle_error_code(err, false, "Cannot get delay for PCM device.");
+
+  return err;
+}
+
+//Like avail_update, but synchronises with the hardware pointer first.
+snd_pcm_sframes_t PCMDevice::get_avail()
+{
+  return backend->avail();
+}
+
+int PCMDevice::get_status(PCMStatus& status)
+{
+  if ((err = backend->status(status)) < 0)
+    handle_error_code(err, false, "Cannot get status for PCM device.");
+
+  return err;
+}
+
+//Float transfers convert through the device's interleaved buffer, so they
+//need interleaved access and a format the conversion engine knows.
+int PCMDevice::check_float_transfer()
+{
+  if (input_params.access_type != SND_PCM_ACCESS_RW_INTERLEAVED && input_params.access_type != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Float transfers require interleaved access.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (!conversion_supported(input_params.format_type))
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "The configured stream format has no float conversion.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  return 0;
+}
+
+PCMPlayer::PCMPlayer(std::string hw_device, int mode) :
+  PCMDevice(hw_device, SND_PCM_STREAM_PLAYBACK, mode),
+  render_running(false),
+  dither_enabled(false)
 {
 }
 
-PCMRecorder::PCMRecorder(std::string hw_device) :
-  PCMDevice(hw_device, SND_PCM_STREAM_CAPTURE)
+PCMPlayer::PCMPlayer(std::unique_ptr<PCMBackend> pcm_backend) :
+  PCMDevice(std::move(pcm_backend)),
+  render_running(false),
+  dither_enabled(false)
 {
+  if (stream_direction != SND_PCM_STREAM_PLAYBACK)
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), true, "PCMPlayer requires a playback backend.");
+}
+
+PCMPlayer::~PCMPlayer()
+{
+  stop_render();
+}
+
+//Starts a library-owned thread that invokes callback once per period as
+//soon as the device has room, rendering straight into the MMAP area when the
+//stream uses MMAP_INTERLEAVED access.
+int PCMPlayer::start_render(RenderCallback callback)
+{
+  return start_render_thread(callback, nullptr);
+}
+
+//As above, but the render thread first applies rt_config (SCHED_FIFO/RR,
+//CPU pinning, memory locking). get_render_thread_status reports what it got.
+int PCMPlayer::start_render(RenderCallback callback, const RtThreadConfig& rt_config)
+{
+  return start_render_thread(callback, &rt_config);
+}
+
+int PCMPlayer::start_render_thread(RenderCallback callback, const RtThreadConfig* rt_config)
+{
+  if (render_running || render_thread.joinable())
+  {
+    handle_error_code(static_cast<int>(std::errc::device_or_resource_busy), false, "Render thread is already running.");
+    return -static_cast<int>(std::errc::device_or_resource_busy);
+  }
+
+  if (input_params.access_type != SND_PCM_ACCESS_RW_INTERLEAVED && input_params.access_type != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Render callbacks require interleaved access.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  snd_pcm_state_t hw_state = backend->state();
+
+  if (hw_state != SND_PCM_STATE_PREPARED && hw_state != SND_PCM_STATE_RUNNING)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "Could not start rendering - device is not prepared.");
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  render_callback = callback;
+
+  if (input_params.access_type == SND_PCM_ACCESS_RW_INTERLEAVED)
+    render_buffer.resize(period_size * frame_size);
+
+  render_running = true;
+  render_thread_status = RtThreadStatus();
+
+  if (rt_config != nullptr)
+    render_thread = spawn_realtime_thread(*rt_config, [this]() { render_loop(); }, render_thread_status);
+  else
+    render_thread = std::thread(&PCMPlayer::render_loop, this);
+
+  return 0;
+}
+
+int PCMPlayer::stop_render()
+{
+  render_running = false;
+
+  if (render_thread.joinable())
+    render_thread.join();
+
+  return 0;
+}
+
+bool PCMPlayer::is_rendering()
+{
+  return render_running;
+}
+
+RtThreadStatus PCMPlayer::get_render_thread_status()
+{
+  return render_thread_status;
+}
+
+void PCMPlayer::render_loop()
+{
+  while (render_running)
+  {
+    snd_pcm_sframes_t avail = backend->avail_update();
+
+    if (avail < 0)
+    {
+      int recover_err = recover(avail);
+
+      if (recover_err == -EAGAIN)
+        std::this_thread::sleep_for(std::chrono::milliseconds(RENDER_WAIT_TIMEOUT_MS)); //Suspended; the device won't wake us.
+      else if (recover_err < 0)
+        break;
+
+      continue;
+    }
+
+    if (static_cast<snd_pcm_uframes_t>(avail) < period_size)
+    {
+      //Buffer is full: start a freshly prepared stream, otherwise sleep
+      //until the hardware frees a period.
+      int wait_err;
+
+      if (backend->state() == SND_PCM_STATE_PREPARED)
+      {
+        if (start() < 0)
+          break;
+      }
+      else if ((wait_err = backend->wait(RENDER_WAIT_TIMEOUT_MS)) < 0)
+      {
+        int recover_err = recover(wait_err);
+
+        if (recover_err < 0 && recover_err != -EAGAIN)
+          break;
+      }
+
+      continue;
+    }
+
+    if (render_period() != 0)
+      break;
+  }
+
+  render_running = false;
+}
+
+//Renders and queues exactly one period. Returns non-zero to stop the thread.
+int PCMPlayer::render_period()
+{
+  if (input_params.access_type == SND_PCM_ACCESS_RW_INTERLEAVED)
+  {
+    if (render_callback(render_buffer.data(), period_size) != 0)
+      return 1;
+
+    snd_pcm_sframes_t queued = transfer_interleaved(render_buffer.data(), period_size);
+    return (queued < 0 && queued != -EAGAIN) ? 1 : 0;
+  }
+
+  //The mapped region may wrap at the end of the ring, in which case the
+  //period is rendered in two pieces.
+  int callback_result = 0;
+
+  snd_pcm_sframes_t queued = mmap_loop(period_size, [this, &callback_result](const MmapArea& area, snd_pcm_uframes_t)
+  {
+    callback_result = render_callback(area.channel_data(0), area.frames);
+    return callback_result;
+  });
+
+  return (callback_result != 0 || (queued < 0 && queued != -EAGAIN)) ? 1 : 0;
+}
+
+//Plays up to max_frames queued by a producer thread. Frames go from the
+//ring to the device without an intermediate copy and without locking.
+//Returns the number of frames consumed from the ring, or a negative error code.
+snd_pcm_sframes_t PCMPlayer::play_from_ring(FrameRingBuffer& ring, snd_pcm_uframes_t max_frames)
+{
+  if (ring.frame_bytes() != frame_size)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Ring buffer frame size does not match the configured stream.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  RingRegion regions[2];
+  ring.read_regions(regions[0], regions[1]);
+
+  snd_pcm_sframes_t played = transfer_ring_regions(regions, max_frames);
+
+  if (played > 0)
+    ring.commit_read(played);
+
+  return played;
+}
+
+//Plays interleaved float samples in [-1.0, 1.0) at the stream rate and
+//channel count on a device of any supported integer or float format. If the
+//device negotiated a different channel count or rate, each period is
+//remixed and then resampled (remixing first, so a downmix shrinks the
+//resampler's work). Software gain and the limiter run last, in place on
+//whichever of those buffers holds the period.
+//Returns the number of frames consumed, or a negative error code.
+snd_pcm_sframes_t PCMPlayer::write_float(const float* samples, snd_pcm_uframes_t frame_count)
+{
+  if (!channel_mixing_active && !resampler.active() && gain_stage.is_bypassed())
+    return write_device_float(samples, frame_count);
+
+  if ((err = check_float_transfer()) < 0)
+    return err;
+
+  int channels = static_cast<int>(stream_channels);
+  unsigned int device_channels = static_cast<int>(input_params.channels);
+  snd_pcm_uframes_t frames_done = 0;
+  transfer_would_block = false;
+
+  while (frames_done < frame_count)
+  {
+    snd_pcm_uframes_t chunk = frame_count - frames_done;
+    chunk = (chunk < period_size) ? chunk : period_size;
+
+    //The mixer and resampler can't take input back, so a non-blocking
+    //device only gets periods it has room for in full.
+    if (nonblocking)
+    {
+      snd_pcm_sframes_t avail = backend->avail_update();
+      snd_pcm_uframes_t needed = resampler.active() ? resampler.max_output_frames(chunk) : chunk;
+
+      if (avail >= 0 && static_cast<snd_pcm_uframes_t>(avail) < needed)
+      {
+        transfer_would_block = true;
+        break;
+      }
+    }
+
+    const float* block = samples + (frames_done * channels);
+    float* owned_block = nullptr; //set once the period is in one of our buffers
+    size_t block_frames = chunk;
+
+    if (channel_mixing_active)
+    {
+      channel_matrix.apply(block, mix_buffer.data(), chunk);
+      block = owned_block = mix_buffer.data();
+    }
+
+    if (resampler.active())
+    {
+      block_frames = resampler.process(block, chunk, resample_buffer.data());
+      block = owned_block = resample_buffer.data();
+    }
+
+    if (!gain_stage.is_bypassed())
+    {
+      if (owned_block == nullptr)
+        owned_block = gain_buffer.data();
+
+      gain_stage.process(block, owned_block, block_frames, device_channels);
+      block = owned_block;
+    }
+
+    if (block_frames > 0)
+    {
+      snd_pcm_sframes_t written = write_device_float(block, block_frames);
+
+      if (written < 0 && written != -EAGAIN)
+        return written;
+    }
+
+    frames_done += chunk;
+
+    if (transfer_would_block)
+      break; //Still suspended, or the room checked above was taken; the period is lost.
+  }
+
+  return transfer_would_block ? transfer_result(frames_done) : frame_count;
+}
+
+//Replaces the preset mix used when the device negotiated a different
+//channel count. The matrix must map the stream's channels to the device's.
+int PCMPlayer::set_channel_matrix(const ChannelMatrix& matrix)
+{
+  if (matrix.input_channels() != static_cast<unsigned int>(stream_channels) || matrix.output_channels() != static_cast<unsigned int>(input_params.channels))
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Channel matrix does not map the stream channels to the device channels.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  channel_matrix = matrix;
+  channel_mixing_active = !channel_matrix.is_identity();
+
+  if (channel_mixing_active)
+    mix_buffer.resize(period_size * static_cast<int>(input_params.channels));
+
+  return 0;
+}
+
+//Converts and queues float frames already at the device rate. Each period
+//is converted straight into the MMAP area when available, otherwise into
+//one preallocated period buffer.
+snd_pcm_sframes_t PCMPlayer::write_device_float(const float* samples, snd_pcm_uframes_t frame_count)
+{
+  if ((err = check_float_transfer()) < 0)
+    return err;
+
+  int channels = static_cast<int>(input_params.channels);
+  DitherState* dither = dither_enabled ? &dither_state : nullptr;
+
+  if (input_params.access_type != SND_PCM_ACCESS_RW_INTERLEAVED)
+  {
+    snd_pcm_sframes_t written = mmap_loop(frame_count, [this, samples, channels, dither](const MmapArea& area, snd_pcm_uframes_t frames_done)
+    {
+      convert_from_float(samples + (frames_done * channels), area.channel_data(0), input_params.format_type, area.frames * channels, dither);
+      return 0;
+    });
+
+    //A recovered xrun drops the rest of the call.
+    return (written < 0 || transfer_would_block) ? written : static_cast<snd_pcm_sframes_t>(frame_count);
+  }
+
+  snd_pcm_uframes_t frames_done = 0;
+  transfer_would_block = false;
+
+  while (frames_done < frame_count)
+  {
+    snd_pcm_uframes_t chunk = frame_count - frames_done;
+    chunk = (chunk < period_size) ? chunk : period_size;
+
+    convert_from_float(samples + (frames_done * channels), conversion_buffer.data(), input_params.format_type, chunk * channels, dither);
+
+    snd_pcm_sframes_t written = transfer_interleaved(conversion_buffer.data(), chunk);
+
+    if (written < 0 && written != -EAGAIN)
+      return written;
+
+    if (transfer_would_block)
+    {
+      frames_done += (written > 0) ? written : 0;
+      break;
+    }
+
+    frames_done += chunk; //A recovered xrun drops the rest of the period.
+  }
+
+  return transfer_would_block ? transfer_result(frames_done) : frame_count;
+}
+
+//Software volume for write_float, as a linear factor. The change ramps
+//linearly over ramp_frames device frames starting with the next write.
+void PCMPlayer::set_gain(float gain, uint32_t ramp_frames)
+{
+  gain_stage.set_target(gain, ramp_frames);
+}
+
+float PCMPlayer::get_gain()
+{
+  return gain_stage.get_target();
+}
+
+//Soft-limits write_float output above threshold before integer conversion.
+void PCMPlayer::set_limiter(bool enabled, float threshold)
+{
+  gain_stage.set_limiter(enabled, threshold);
+}
+
+//TPDF dither on float-to-integer conversion, for formats of 24 bits or less.
+void PCMPlayer::set_dither(bool enabled)
+{
+  dither_enabled = enabled;
+}
+
+PCMRecorder::PCMRecorder(std::string hw_device, int mode) :
+  PCMDevice(hw_device, SND_PCM_STREAM_CAPTURE, mode)
+{
+}
+
+PCMRecorder::PCMRecorder(std::unique_ptr<PCMBackend> pcm_backend) :
+  PCMDevice(std::move(pcm_backend))
+{
+  if (stream_direction != SND_PCM_STREAM_CAPTURE)
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), true, "PCMRecorder requires a capture backend.");
+}
+
+//Captures up to max_frames into free ring space for a consumer thread to
+//drain. Returns the number of frames queued, or a negative error code.
+snd_pcm_sframes_t PCMRecorder::record_into_ring(FrameRingBuffer& ring, snd_pcm_uframes_t max_frames)
+{
+  if (ring.frame_bytes() != frame_size)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Ring buffer frame size does not match the configured stream.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  RingRegion regions[2];
+  ring.write_regions(regions[0], regions[1]);
+
+  snd_pcm_sframes_t captured = transfer_ring_regions(regions, max_frames);
+
+  if (captured > 0)
+    ring.commit_write(captured);
+
+  return captured;
+}
+
+//Captures interleaved frames as float samples in [-1.0, 1.0), converting
+//straight out of the MMAP area when available.
+//Returns the number of frames captured, or a negative error code.
+snd_pcm_sframes_t PCMRecorder::read_float(float* samples, snd_pcm_uframes_t frame_count)
+{
+  if ((err = check_float_transfer()) < 0)
+    return err;
+
+  int channels = static_cast<int>(input_params.channels);
+
+  if (input_params.access_type != SND_PCM_ACCESS_RW_INTERLEAVED)
+  {
+    return mmap_loop(frame_count, [this, samples, channels](const MmapArea& area, snd_pcm_uframes_t frames_done)
+    {
+      convert_to_float(area.channel_data(0), samples + (frames_done * channels), input_params.format_type, area.frames * channels);
+      return 0;
+    });
+  }
+
+  snd_pcm_uframes_t frames_done = 0;
+  transfer_would_block = false;
+
+  while (frames_done < frame_count)
+  {
+    snd_pcm_uframes_t chunk = frame_count - frames_done;
+    chunk = (chunk < period_size) ? chunk : period_size;
+    snd_pcm_sframes_t captured = transfer_interleaved(conversion_buffer.data(), chunk);
+
+    if (captured < 0)
+      return (captured == -EAGAIN) ? transfer_result(frames_done) : captured;
+
+    convert_to_float(conversion_buffer.data(), samples + (frames_done * channels), input_params.format_type, captured * channels);
+    frames_done += captured;
+
+    if (static_cast<snd_pcm_uframes_t>(captured) < chunk)
+      break; //Overrun recovered mid-read, or nothing more captured yet.
+  }
+
+  return transfer_result(frames_done);
 }
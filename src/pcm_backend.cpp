@@ -0,0 +1,379 @@
+#include <alsaplusplus/pcm_backend.hpp>
+
+using namespace AlsaPlusPlus;
+
+AlsaBackend::AlsaBackend(std::string hw_device, snd_pcm_stream_t stream_type, int mode) :
+  err(0),
+  device_name(hw_device),
+  stream_direction(stream_type),
+  pcm_handle(nullptr),
+  nonblocking((mode & SND_PCM_NONBLOCK) != 0)
+{
+  if ((err = snd_pcm_open(&pcm_handle, device_name.c_str(), stream_type, mode)) < 0)
+    handle_error_code(err, true, "Cannot open handle to PCM audio device.");
+}
+
+AlsaBackend::~AlsaBackend()
+{
+  snd_pcm_close(pcm_handle);
+}
+
+std::string AlsaBackend::get_name()
+{
+  return device_name;
+}
+
+snd_pcm_stream_t AlsaBackend::get_stream_direction()
+{
+  return stream_direction;
+}
+
+//Everything up to the buffer layout, shared by configuring and probing.
+int AlsaBackend::restrict_hw_params(snd_pcm_hw_params_t* hw_params, HwConfig& config)
+{
+  if ((err = snd_pcm_hw_params_any(pcm_handle, hw_params)) < 0)
+  {
+    handle_error_code(err, false, "Cannot initialize hardware parameter structure for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_hw_params_set_access(pcm_handle, hw_params, config.access_type)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set access type for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_hw_params_set_format(pcm_handle, hw_params, config.format_type)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set sample format for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_hw_params_set_channels(pcm_handle, hw_params, config.channels)) < 0)
+  {
+    if (!config.channels_near || (err = snd_pcm_hw_params_set_channels_near(pcm_handle, hw_params, &config.channels)) < 0)
+    {
+      handle_error_code(err, false, "Cannot set channel count for PCM object.");
+      return err;
+    }
+  }
+
+  if ((err = snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &config.sample_rate_hz, 0)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set sample rate for PCM object.");
+    return err;
+  }
+
+  return 0;
+}
+
+int AlsaBackend::hw_params(HwConfig& config)
+{
+  snd_pcm_hw_params_t* hw_params;
+  snd_pcm_hw_params_alloca(&hw_params);
+
+  if ((err = restrict_hw_params(hw_params, config)) < 0)
+    return err;
+
+  if (config.period_size > 0)
+  {
+    if ((err = snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &config.period_size, 0)) < 0)
+    {
+      handle_error_code(err, false, "Cannot set period size for PCM object.");
+      return err;
+    }
+  }
+  else if ((err = snd_pcm_hw_params_set_period_time_near(pcm_handle, hw_params, &config.period_time_us, 0)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set period time for PCM object.");
+    return err;
+  }
+
+  if (config.periods > 0)
+  {
+    if ((err = snd_pcm_hw_params_set_periods_near(pcm_handle, hw_params, &config.periods, 0)) < 0)
+    {
+      handle_error_code(err, false, "Cannot set period count for PCM object.");
+      return err;
+    }
+  }
+  else if (config.buffer_time_us > 0)
+  {
+    if ((err = snd_pcm_hw_params_set_buffer_time_near(pcm_handle, hw_params, &config.buffer_time_us, 0)) < 0)
+    {
+      handle_error_code(err, false, "Cannot set buffer time for PCM object.");
+      return err;
+    }
+  }
+
+  if ((err = snd_pcm_hw_params(pcm_handle, hw_params)) < 0)
+  {
+    handle_error_code(err, false, "Cannot apply hardware parameters to PCM device.");
+    return err;
+  }
+
+  //Read the layout back only after the configuration is applied - before
+  //that it is still a set of ranges.
+  if ((err = snd_pcm_hw_params_get_period_size(hw_params, &config.period_size, 0)) < 0)
+  {
+    handle_error_code(err, false, "Could not get period size for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_hw_params_get_buffer_size(hw_params, &config.buffer_size)) < 0)
+  {
+    handle_error_code(err, false, "Could not get buffer size for PCM object.");
+    return err;
+  }
+
+  snd_pcm_hw_params_get_period_time(hw_params, &config.period_time_us, 0);
+  snd_pcm_hw_params_get_periods(hw_params, &config.periods, 0);
+  snd_pcm_hw_params_get_buffer_time(hw_params, &config.buffer_time_us, 0);
+
+  return 0;
+}
+
+int AlsaBackend::hw_ranges(const HwConfig& config, HwRanges& ranges)
+{
+  snd_pcm_hw_params_t* hw_params;
+  snd_pcm_hw_params_alloca(&hw_params);
+  HwConfig restricted = config;
+
+  if ((err = restrict_hw_params(hw_params, restricted)) < 0)
+    return err;
+
+  ranges.sample_rate_hz = restricted.sample_rate_hz;
+  snd_pcm_hw_params_get_period_size_min(hw_params, &ranges.period_size_min, 0);
+  snd_pcm_hw_params_get_period_size_max(hw_params, &ranges.period_size_max, 0);
+  snd_pcm_hw_params_get_periods_min(hw_params, &ranges.periods_min, 0);
+  snd_pcm_hw_params_get_periods_max(hw_params, &ranges.periods_max, 0);
+  snd_pcm_hw_params_get_buffer_size_min(hw_params, &ranges.buffer_size_min);
+  snd_pcm_hw_params_get_buffer_size_max(hw_params, &ranges.buffer_size_max);
+
+  return 0;
+}
+
+int AlsaBackend::hw_params_test(const HwConfig& config)
+{
+  snd_pcm_hw_params_t* hw_params;
+  snd_pcm_hw_params_alloca(&hw_params);
+  HwConfig restricted = config;
+
+  if ((err = restrict_hw_params(hw_params, restricted)) < 0)
+    return err;
+
+  //Rejections are the expected outcome of a probe, so they aren't reported.
+  if ((err = snd_pcm_hw_params_set_period_size(pcm_handle, hw_params, config.period_size, 0)) < 0)
+    return err;
+
+  return snd_pcm_hw_params_test_periods(pcm_handle, hw_params, config.periods, 0);
+}
+
+int AlsaBackend::sw_params_current(SwParams& params)
+{
+  snd_pcm_sw_params_t* sw_params;
+  snd_pcm_sw_params_alloca(&sw_params);
+
+  if ((err = snd_pcm_sw_params_current(pcm_handle, sw_params)) < 0)
+  {
+    handle_error_code(err, false, "Cannot read software parameters for PCM object.");
+    return err;
+  }
+
+  int period_event = 0;
+  snd_pcm_tstamp_t tstamp_mode = SND_PCM_TSTAMP_NONE;
+
+  snd_pcm_sw_params_get_start_threshold(sw_params, &params.start_threshold);
+  snd_pcm_sw_params_get_stop_threshold(sw_params, &params.stop_threshold);
+  snd_pcm_sw_params_get_avail_min(sw_params, &params.avail_min);
+  snd_pcm_sw_params_get_silence_threshold(sw_params, &params.silence_threshold);
+  snd_pcm_sw_params_get_silence_size(sw_params, &params.silence_size);
+  snd_pcm_sw_params_get_period_event(sw_params, &period_event);
+  snd_pcm_sw_params_get_tstamp_mode(sw_params, &tstamp_mode);
+
+  params.period_event = (period_event != 0);
+  params.timestamps = (tstamp_mode != SND_PCM_TSTAMP_NONE);
+
+  return 0;
+}
+
+int AlsaBackend::sw_params(const SwParams& params)
+{
+  snd_pcm_sw_params_t* sw_params;
+  snd_pcm_sw_params_alloca(&sw_params);
+
+  if ((err = snd_pcm_sw_params_current(pcm_handle, sw_params)) < 0)
+  {
+    handle_error_code(err, false, "Cannot initialize software parameter structure for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_start_threshold(pcm_handle, sw_params, params.start_threshold)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set start threshold for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_stop_threshold(pcm_handle, sw_params, params.stop_threshold)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set stop threshold for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_avail_min(pcm_handle, sw_params, params.avail_min)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set minimum available frames for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_silence_threshold(pcm_handle, sw_params, params.silence_threshold)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set silence threshold for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_silence_size(pcm_handle, sw_params, params.silence_size)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set silence size for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_period_event(pcm_handle, sw_params, params.period_event ? 1 : 0)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set period event for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params_set_tstamp_mode(pcm_handle, sw_params, params.timestamps ? SND_PCM_TSTAMP_ENABLE : SND_PCM_TSTAMP_NONE)) < 0)
+  {
+    handle_error_code(err, false, "Cannot set timestamp mode for PCM object.");
+    return err;
+  }
+
+  if ((err = snd_pcm_sw_params(pcm_handle, sw_params)) < 0)
+  {
+    handle_error_code(err, false, "Cannot apply software parameters to PCM device.");
+    return err;
+  }
+
+  return 0;
+}
+
+snd_pcm_state_t AlsaBackend::state()
+{
+  return snd_pcm_state(pcm_handle);
+}
+
+int AlsaBackend::prepare()
+{
+  return snd_pcm_prepare(pcm_handle);
+}
+
+int AlsaBackend::start()
+{
+  return snd_pcm_start(pcm_handle);
+}
+
+int AlsaBackend::resume()
+{
+  return snd_pcm_resume(pcm_handle);
+}
+
+int AlsaBackend::nonblock(int nonblock)
+{
+  if ((err = snd_pcm_nonblock(pcm_handle, nonblock)) < 0)
+    return err;
+
+  nonblocking = (nonblock != 0);
+  return 0;
+}
+
+bool AlsaBackend::is_nonblocking()
+{
+  return nonblocking;
+}
+
+snd_pcm_sframes_t AlsaBackend::avail_update()
+{
+  return snd_pcm_avail_update(pcm_handle);
+}
+
+snd_pcm_sframes_t AlsaBackend::avail()
+{
+  return snd_pcm_avail(pcm_handle);
+}
+
+int AlsaBackend::delay(snd_pcm_sframes_t& delay)
+{
+  return snd_pcm_delay(pcm_handle, &delay);
+}
+
+int AlsaBackend::wait(int timeout_ms)
+{
+  return snd_pcm_wait(pcm_handle, timeout_ms);
+}
+
+int AlsaBackend::status(PCMStatus& status)
+{
+  snd_pcm_status_t* pcm_status;
+  snd_pcm_status_alloca(&pcm_status);
+
+  if ((err = snd_pcm_status(pcm_handle, pcm_status)) < 0)
+    return err;
+
+  status.state = snd_pcm_status_get_state(pcm_status);
+  snd_pcm_status_get_trigger_htstamp(pcm_status, &status.trigger_timestamp);
+  snd_pcm_status_get_htstamp(pcm_status, &status.timestamp);
+  snd_pcm_status_get_audio_htstamp(pcm_status, &status.audio_timestamp);
+  status.delay = snd_pcm_status_get_delay(pcm_status);
+  status.avail = snd_pcm_status_get_avail(pcm_status);
+  status.avail_max = snd_pcm_status_get_avail_max(pcm_status);
+  status.overrange = snd_pcm_status_get_overrange(pcm_status);
+
+  return 0;
+}
+
+snd_pcm_sframes_t AlsaBackend::writei(const void* frames, snd_pcm_uframes_t frame_count)
+{
+  return snd_pcm_writei(pcm_handle, frames, frame_count);
+}
+
+snd_pcm_sframes_t AlsaBackend::readi(void* frames, snd_pcm_uframes_t frame_count)
+{
+  return snd_pcm_readi(pcm_handle, frames, frame_count);
+}
+
+snd_pcm_sframes_t AlsaBackend::writen(void** channels, snd_pcm_uframes_t frame_count)
+{
+  return snd_pcm_writen(pcm_handle, channels, frame_count);
+}
+
+snd_pcm_sframes_t AlsaBackend::readn(void** channels, snd_pcm_uframes_t frame_count)
+{
+  return snd_pcm_readn(pcm_handle, channels, frame_count);
+}
+
+int AlsaBackend::mmap_begin(const snd_pcm_channel_area_t** areas, snd_pcm_uframes_t* offset, snd_pcm_uframes_t* frames)
+{
+  return snd_pcm_mmap_begin(pcm_handle, areas, offset, frames);
+}
+
+snd_pcm_sframes_t AlsaBackend::mmap_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+  return snd_pcm_mmap_commit(pcm_handle, offset, frames);
+}
+
+int AlsaBackend::poll_descriptors_count()
+{
+  return snd_pcm_poll_descriptors_count(pcm_handle);
+}
+
+int AlsaBackend::poll_descriptors(struct pollfd* fds, unsigned int space)
+{
+  return snd_pcm_poll_descriptors(pcm_handle, fds, space);
+}
+
+int AlsaBackend::poll_descriptors_revents(struct pollfd* fds, unsigned int count, unsigned short* revents)
+{
+  return snd_pcm_poll_descriptors_revents(pcm_handle, fds, count, revents);
+}
@@ -0,0 +1,126 @@
+#include <alsaplusplus/realtime.hpp>
+
+#include <future>
+
+extern "C"
+{
+#include <alloca.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+}
+
+using namespace AlsaPlusPlus;
+
+namespace
+{
+  int try_set_scheduler(int policy, int priority)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    return pthread_setschedparam(pthread_self(), policy, &param);
+  }
+
+  //Touches the next bytes of stack so later deep calls in the audio path
+  //don't page-fault. Kept out of line so the alloca'd frame is really used.
+  __attribute__((noinline)) void prefault_stack(size_t bytes)
+  {
+    volatile char* stack = static_cast<volatile char*>(alloca(bytes));
+
+    for (size_t i = 0; i < bytes; i += 4096)
+      stack[i] = 0;
+  }
+}
+
+//Applies config to the calling thread, degrading step by step when the
+//process lacks the privileges for what was asked.
+RtThreadStatus AlsaPlusPlus::apply_realtime_config(const RtThreadConfig& config)
+{
+  RtThreadStatus status;
+
+  if (config.policy == SCHED_FIFO || config.policy == SCHED_RR)
+  {
+    int min_prio = sched_get_priority_min(config.policy);
+    int max_prio = sched_get_priority_max(config.policy);
+    int priority = config.priority;
+
+    priority = (priority < min_prio) ? min_prio : priority;
+    priority = (priority > max_prio) ? max_prio : priority;
+
+    int sched_err = try_set_scheduler(config.policy, priority);
+
+    if (sched_err == EPERM)
+    {
+      //Unprivileged processes may still go up to RLIMIT_RTPRIO.
+      struct rlimit limit;
+
+      if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur > 0 && static_cast<rlim_t>(priority) > limit.rlim_cur)
+      {
+        priority = static_cast<int>(limit.rlim_cur);
+        status.priority_clamped = true;
+        sched_err = try_set_scheduler(config.policy, priority);
+      }
+    }
+
+    if (sched_err == 0)
+    {
+      status.policy = config.policy;
+      status.priority = priority;
+    }
+    else
+    {
+      handle_error_code(-sched_err, false, "Cannot give audio thread real-time priority; staying on SCHED_OTHER.");
+    }
+  }
+
+  if (!config.cpus.empty())
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    for (int cpu : config.cpus)
+      CPU_SET(cpu, &cpu_set);
+
+    int affinity_err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+
+    if (affinity_err == 0)
+      status.affinity_set = true;
+    else
+      handle_error_code(-affinity_err, false, "Cannot pin audio thread to the requested CPUs.");
+  }
+
+  if (config.lock_memory)
+  {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+      status.memory_locked = true;
+    else
+      handle_error_code(-errno, false, "Cannot lock process memory for audio thread.");
+  }
+
+  if (config.prefault_stack_bytes > 0)
+  {
+    prefault_stack(config.prefault_stack_bytes);
+    status.stack_prefaulted = true;
+  }
+
+  return status;
+}
+
+//Starts body on a new thread configured with config. Returns once the
+//thread has applied its settings, with status describing what it got.
+std::thread AlsaPlusPlus::spawn_realtime_thread(const RtThreadConfig& config, std::function<void()> body, RtThreadStatus& status)
+{
+  std::promise<RtThreadStatus> applied;
+  std::future<RtThreadStatus> applied_status = applied.get_future();
+
+  std::thread rt_thread([config, body, applied = std::move(applied)]() mutable
+  {
+    applied.set_value(apply_realtime_config(config));
+    body();
+  });
+
+  status = applied_status.get();
+  return rt_thread;
+}
@@ -0,0 +1,292 @@
+#include <alsaplusplus/resampler.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ALSAPLUSPLUS_RESAMPLER_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ALSAPLUSPLUS_RESAMPLER_NEON
+#endif
+
+using namespace AlsaPlusPlus;
+
+//Rate pairs whose reduced ratio needs more phases than this (e.g. 44100 to
+//44101) would need an impractically large coefficient table.
+constexpr unsigned int RESAMPLER_MAX_PHASES = 1024;
+constexpr unsigned int RESAMPLER_MAX_TAPS = 256;
+
+namespace
+{
+  struct QualityTier
+  {
+    unsigned int taps; //per phase, when upsampling
+    double kaiser_beta;
+    double cutoff; //passband edge as a fraction of the lower Nyquist rate
+  };
+
+  QualityTier quality_tier(ResamplerQuality quality)
+  {
+    switch (quality)
+    {
+      case ResamplerQuality::FAST:
+        return {16, 6.0, 0.90};
+      case ResamplerQuality::HIGH:
+        return {64, 10.0, 0.97};
+      default:
+        return {32, 8.0, 0.94};
+    }
+  }
+
+  unsigned int gcd(unsigned int a, unsigned int b)
+  {
+    while (b != 0)
+    {
+      unsigned int r = a % b;
+      a = b;
+      b = r;
+    }
+
+    return a;
+  }
+
+  //Zeroth-order modified Bessel function, for the Kaiser window.
+  double bessel_i0(double x)
+  {
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 50; k++)
+    {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+
+      if (term < sum * 1e-12)
+        break;
+    }
+
+    return sum;
+  }
+
+#if defined(ALSAPLUSPLUS_RESAMPLER_X86)
+  //SSE2 - baseline on x86_64. taps is always a multiple of 4.
+  __attribute__((target("sse2"))) inline float dot_product(const float* a, const float* b, unsigned int n)
+  {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    unsigned int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    for (; i + 4 <= n; i += 4)
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+
+    return _mm_cvtss_f32(acc0);
+  }
+#elif defined(ALSAPLUSPLUS_RESAMPLER_NEON)
+  inline float dot_product(const float* a, const float* b, unsigned int n)
+  {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    unsigned int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+      acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+      acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+
+    for (; i + 4 <= n; i += 4)
+      acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+  }
+#else
+  inline float dot_product(const float* a, const float* b, unsigned int n)
+  {
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (unsigned int i = 0; i < n; i += 4)
+    {
+      acc[0] += a[i] * b[i];
+      acc[1] += a[i + 1] * b[i + 1];
+      acc[2] += a[i + 2] * b[i + 2];
+      acc[3] += a[i + 3] * b[i + 3];
+    }
+
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  }
+#endif
+}
+
+Resampler::Resampler() :
+  channel_count(0),
+  upsample(1),
+  downsample(1),
+  taps(0),
+  max_input(0),
+  plane_frames(0),
+  buffered_frames(0),
+  position(0),
+  enabled(false)
+{
+}
+
+int Resampler::configure(unsigned int input_rate, unsigned int output_rate, unsigned int channels, ResamplerQuality quality, size_t max_input_frames)
+{
+  enabled = false;
+  coefficients.clear();
+  history.clear();
+
+  if (input_rate == 0 || output_rate == 0 || channels == 0 || max_input_frames == 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Resampler needs non-zero rates, channels and block size.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  if (input_rate == output_rate || quality == ResamplerQuality::DISABLED)
+    return 0;
+
+  unsigned int divisor = gcd(input_rate, output_rate);
+  upsample = output_rate / divisor;
+  downsample = input_rate / divisor;
+
+  if (upsample > RESAMPLER_MAX_PHASES)
+  {
+    char rates[48];
+    snprintf(rates, sizeof(rates), "%uHz to %uHz", input_rate, output_rate);
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Cannot resample - ratio needs too many filter phases.", rates);
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  //When decimating, the cutoff drops below the input Nyquist rate and the
+  //filter is stretched by the same factor to keep its stopband.
+  QualityTier tier = quality_tier(quality);
+  double bandwidth = (upsample < downsample) ? static_cast<double>(upsample) / downsample : 1.0;
+  unsigned int tap_count = static_cast<unsigned int>(std::ceil(tier.taps / bandwidth));
+  tap_count = (tap_count + 3) & ~3u;
+  taps = (tap_count < RESAMPLER_MAX_TAPS) ? tap_count : RESAMPLER_MAX_TAPS;
+
+  channel_count = channels;
+  max_input = max_input_frames;
+  plane_frames = (taps - 1) + max_input;
+  coefficients.resize(static_cast<size_t>(upsample) * taps);
+  history.resize(plane_frames * channel_count);
+
+  double cutoff = tier.cutoff * bandwidth;
+  double half_width = taps / 2.0;
+  double window_norm = bessel_i0(tier.kaiser_beta);
+
+  //Phase p, tap k weighs the input frame at distance d from the output
+  //instant, which sits p/L of a frame after tap (taps / 2 - 1).
+  for (unsigned int phase = 0; phase < upsample; phase++)
+  {
+    float* row = &coefficients[static_cast<size_t>(phase) * taps];
+    double sum = 0.0;
+
+    for (unsigned int k = 0; k < taps; k++)
+    {
+      double d = static_cast<double>(k) - (half_width - 1.0) - static_cast<double>(phase) / upsample;
+      double x = cutoff * d;
+      double sinc = (std::fabs(x) < 1e-12) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+      double r = d / half_width;
+      double window = (std::fabs(r) < 1.0) ? bessel_i0(tier.kaiser_beta * std::sqrt(1.0 - r * r)) / window_norm : 0.0;
+
+      row[k] = static_cast<float>(cutoff * sinc * window);
+      sum += row[k];
+    }
+
+    //Unity DC gain on every phase, so no phase-dependent ripple.
+    for (unsigned int k = 0; k < taps; k++)
+      row[k] = static_cast<float>(row[k] / sum);
+  }
+
+  enabled = true;
+  reset();
+
+  return 0;
+}
+
+void Resampler::reset()
+{
+  std::fill(history.begin(), history.end(), 0.0f);
+  buffered_frames = (taps > 0) ? taps - 1 : 0;
+  position = 0;
+}
+
+size_t Resampler::process(const float* input, size_t input_frames, float* output)
+{
+  if (!enabled)
+    return 0;
+
+  if (input_frames > max_input)
+    input_frames = max_input;
+
+  //Deinterleave behind the carried-over tail so each channel's filter
+  //window is contiguous.
+  for (unsigned int channel = 0; channel < channel_count; channel++)
+  {
+    float* plane = &history[channel * plane_frames] + buffered_frames;
+
+    for (size_t frame = 0; frame < input_frames; frame++)
+      plane[frame] = input[frame * channel_count + channel];
+  }
+
+  buffered_frames += input_frames;
+
+  size_t produced = 0;
+
+  while ((position / upsample) + taps <= buffered_frames)
+  {
+    size_t base = position / upsample;
+    const float* row = &coefficients[(position % upsample) * taps];
+
+    for (unsigned int channel = 0; channel < channel_count; channel++)
+      output[produced * channel_count + channel] = dot_product(row, &history[channel * plane_frames] + base, taps);
+
+    produced++;
+    position += downsample;
+  }
+
+  //Keep the last taps - 1 frames for the next call's windows.
+  size_t consumed = buffered_frames - (taps - 1);
+
+  for (unsigned int channel = 0; channel < channel_count; channel++)
+  {
+    float* plane = &history[channel * plane_frames];
+    memmove(plane, plane + consumed, (taps - 1) * sizeof(float));
+  }
+
+  buffered_frames = taps - 1;
+  position -= static_cast<uint64_t>(consumed) * upsample;
+
+  return produced;
+}
+
+size_t Resampler::max_output_frames(size_t input_frames) const
+{
+  if (!enabled)
+    return input_frames;
+
+  return ((input_frames + 1) * upsample) / downsample + 1;
+}
+
+bool Resampler::active() const
+{
+  return enabled;
+}
+
+unsigned int Resampler::latency_frames() const
+{
+  return enabled ? taps / 2 : 0;
+}
@@ -0,0 +1,174 @@
+#include <alsaplusplus/ring_buffer.hpp>
+
+#include <cstdlib>
+
+using namespace AlsaPlusPlus;
+
+constexpr size_t RING_BUFFER_ALIGNMENT = 64;
+
+FrameRingBuffer::FrameRingBuffer(size_t frame_size, size_t period_frames, size_t periods) :
+  frame_size(frame_size),
+  period_size(period_frames),
+  capacity_frames(period_frames * periods),
+  storage(nullptr),
+  write_index(0),
+  cached_read_index(0),
+  read_index(0),
+  cached_write_index(0)
+{
+  if (frame_size == 0 || capacity_frames == 0)
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), true, "Ring buffer needs a non-zero frame size and capacity.");
+
+  void* block = nullptr;
+
+  if (posix_memalign(&block, RING_BUFFER_ALIGNMENT, capacity_frames * frame_size) != 0)
+    handle_error_code(static_cast<int>(std::errc::not_enough_memory), true, "Cannot allocate ring buffer storage.");
+
+  //Touch every page now so the audio thread never takes a first-use fault.
+  memset(block, 0, capacity_frames * frame_size);
+  storage = static_cast<char*>(block);
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+  free(storage);
+}
+
+size_t FrameRingBuffer::write_available() const
+{
+  return capacity_frames - (write_index.load(std::memory_order_relaxed) - read_index.load(std::memory_order_acquire));
+}
+
+size_t FrameRingBuffer::read_available() const
+{
+  return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_relaxed);
+}
+
+//Free space from the write position on, as at most two regions. At least a
+//period is reported whenever the consumer has made that much room.
+size_t FrameRingBuffer::write_regions(RingRegion& first, RingRegion& second)
+{
+  return map_write_regions(first, second, period_size);
+}
+
+//The cached read index is only trusted while it already shows frames_wanted
+//free frames; otherwise the consumer's index is reloaded.
+size_t FrameRingBuffer::map_write_regions(RingRegion& first, RingRegion& second, size_t frames_wanted)
+{
+  uint64_t head = write_index.load(std::memory_order_relaxed);
+  size_t free_frames = capacity_frames - (head - cached_read_index);
+
+  if (free_frames < frames_wanted)
+  {
+    cached_read_index = read_index.load(std::memory_order_acquire);
+    free_frames = capacity_frames - (head - cached_read_index);
+  }
+
+  size_t position = head % capacity_frames;
+  size_t until_end = capacity_frames - position;
+
+  first.data = storage + (position * frame_size);
+  first.frames = (free_frames < until_end) ? free_frames : until_end;
+  second.data = storage;
+  second.frames = free_frames - first.frames;
+
+  return free_frames;
+}
+
+void FrameRingBuffer::commit_write(size_t frame_count)
+{
+  write_index.store(write_index.load(std::memory_order_relaxed) + frame_count, std::memory_order_release);
+}
+
+//Queued frames from the read position on, as at most two regions. At least
+//a period is reported whenever the producer has queued that much.
+size_t FrameRingBuffer::read_regions(RingRegion& first, RingRegion& second)
+{
+  return map_read_regions(first, second, period_size);
+}
+
+size_t FrameRingBuffer::map_read_regions(RingRegion& first, RingRegion& second, size_t frames_wanted)
+{
+  uint64_t tail = read_index.load(std::memory_order_relaxed);
+  size_t used_frames = cached_write_index - tail;
+
+  if (used_frames < frames_wanted)
+  {
+    cached_write_index = write_index.load(std::memory_order_acquire);
+    used_frames = cached_write_index - tail;
+  }
+
+  size_t position = tail % capacity_frames;
+  size_t until_end = capacity_frames - position;
+
+  first.data = storage + (position * frame_size);
+  first.frames = (used_frames < until_end) ? used_frames : until_end;
+  second.data = storage;
+  second.frames = used_frames - first.frames;
+
+  return used_frames;
+}
+
+void FrameRingBuffer::commit_read(size_t frame_count)
+{
+  read_index.store(read_index.load(std::memory_order_relaxed) + frame_count, std::memory_order_release);
+}
+
+//Copies up to frame_count frames in. Returns the number accepted, which is
+//less than requested when the consumer has fallen behind.
+size_t FrameRingBuffer::write(const void* frames, size_t frame_count)
+{
+  RingRegion first, second;
+  size_t free_frames = map_write_regions(first, second, frame_count);
+  size_t to_write = (frame_count < free_frames) ? frame_count : free_frames;
+  size_t first_frames = (to_write < first.frames) ? to_write : first.frames;
+  const char* data = static_cast<const char*>(frames);
+
+  memcpy(first.data, data, first_frames * frame_size);
+
+  if (to_write > first_frames)
+    memcpy(second.data, data + (first_frames * frame_size), (to_write - first_frames) * frame_size);
+
+  commit_write(to_write);
+  return to_write;
+}
+
+size_t FrameRingBuffer::read(void* frames, size_t frame_count)
+{
+  RingRegion first, second;
+  size_t used_frames = map_read_regions(first, second, frame_count);
+  size_t to_read = (frame_count < used_frames) ? frame_count : used_frames;
+  size_t first_frames = (to_read < first.frames) ? to_read : first.frames;
+  char* data = static_cast<char*>(frames);
+
+  memcpy(data, first.data, first_frames * frame_size);
+
+  if (to_read > first_frames)
+    memcpy(data + (first_frames * frame_size), second.data, (to_read - first_frames) * frame_size);
+
+  commit_read(to_read);
+  return to_read;
+}
+
+size_t FrameRingBuffer::capacity() const
+{
+  return capacity_frames;
+}
+
+size_t FrameRingBuffer::frame_bytes() const
+{
+  return frame_size;
+}
+
+size_t FrameRingBuffer::period_frames() const
+{
+  return period_size;
+}
+
+void FrameRingBuffer::reset()
+{
+  write_index.store(0, std::memory_order_relaxed);
+  read_index.store(0, std::memory_order_relaxed);
+  cached_read_index = 0;
+  cached_write_index = 0;
+}
@@ -0,0 +1,300 @@
+#include <alsaplusplus/wav_file.hpp>
+
+extern "C"
+{
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+using namespace AlsaPlusPlus;
+
+constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+constexpr uint32_t RF64_SIZE_IN_DS64 = 0xFFFFFFFF;
+
+namespace
+{
+  //WAV is little-endian throughout; assembled bytewise so unaligned chunk
+  //fields and big-endian hosts are both fine.
+  uint16_t read_u16(const uint8_t* bytes)
+  {
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+  }
+
+  uint32_t read_u32(const uint8_t* bytes)
+  {
+    return static_cast<uint32_t>(read_u16(bytes)) | (static_cast<uint32_t>(read_u16(bytes + 2)) << 16);
+  }
+
+  uint64_t read_u64(const uint8_t* bytes)
+  {
+    return static_cast<uint64_t>(read_u32(bytes)) | (static_cast<uint64_t>(read_u32(bytes + 4)) << 32);
+  }
+
+  bool chunk_is(const uint8_t* bytes, const char* id)
+  {
+    return memcmp(bytes, id, 4) == 0;
+  }
+
+  int malformed(const char* error_desc)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, error_desc);
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  snd_pcm_format_t pcm_format_for(uint16_t format_tag, uint16_t bits_per_sample)
+  {
+    if (format_tag == WAVE_FORMAT_IEEE_FLOAT)
+      return (bits_per_sample == 32) ? SND_PCM_FORMAT_FLOAT_LE : SND_PCM_FORMAT_UNKNOWN;
+
+    //Samples narrower than their container are left-justified in WAV, so a
+    //32-bit container is S32_LE whatever valid_bits says.
+    switch (bits_per_sample)
+    {
+      case 8:
+        return SND_PCM_FORMAT_U8;
+      case 16:
+        return SND_PCM_FORMAT_S16_LE;
+      case 24:
+        return SND_PCM_FORMAT_S24_3LE;
+      case 32:
+        return SND_PCM_FORMAT_S32_LE;
+      default:
+        return SND_PCM_FORMAT_UNKNOWN;
+    }
+  }
+
+  int parse_fmt_chunk(const uint8_t* chunk, uint32_t chunk_size, WavFormat& format)
+  {
+    if (chunk_size < 16)
+      return malformed("WAV fmt chunk is too short.");
+
+    format.format_tag = read_u16(chunk);
+    format.channels = read_u16(chunk + 2);
+    format.sample_rate_hz = read_u32(chunk + 4);
+    format.block_align = read_u16(chunk + 12);
+    format.bits_per_sample = read_u16(chunk + 14);
+    format.valid_bits = format.bits_per_sample;
+    format.channel_mask = 0;
+
+    if (format.format_tag == WAVE_FORMAT_EXTENSIBLE)
+    {
+      //cbSize, valid bits, channel mask, then a GUID whose first two bytes
+      //are the real format tag.
+      if (chunk_size < 40 || read_u16(chunk + 16) < 22)
+        return malformed("WAV extensible fmt chunk is too short.");
+
+      format.valid_bits = read_u16(chunk + 18);
+      format.channel_mask = read_u32(chunk + 20);
+      format.format_tag = read_u16(chunk + 24);
+    }
+
+    if (format.format_tag != WAVE_FORMAT_PCM && format.format_tag != WAVE_FORMAT_IEEE_FLOAT)
+    {
+      handle_error_code(static_cast<int>(std::errc::not_supported), false, "WAV file is neither integer PCM nor IEEE float.");
+      return -static_cast<int>(std::errc::not_supported);
+    }
+
+    if (format.channels == 0 || format.sample_rate_hz == 0 || format.block_align != format.channels * ((format.bits_per_sample + 7) / 8))
+      return malformed("WAV fmt chunk has inconsistent channel, rate or block alignment fields.");
+
+    format.pcm_format = pcm_format_for(format.format_tag, format.bits_per_sample);
+
+    return 0;
+  }
+}
+
+int AlsaPlusPlus::parse_wav_header(const uint8_t* bytes, size_t size, WavLayout& layout)
+{
+  if (size < 12 || !chunk_is(bytes + 8, "WAVE"))
+    return malformed("Not a WAV file.");
+
+  bool rf64 = chunk_is(bytes, "RF64");
+
+  if (!rf64 && !chunk_is(bytes, "RIFF"))
+    return malformed("Not a WAV file.");
+
+  uint64_t ds64_data_bytes = WAV_DATA_SIZE_UNKNOWN;
+  bool have_format = false;
+  size_t position = 12;
+
+  while (position + 8 <= size)
+  {
+    const uint8_t* chunk = bytes + position;
+    uint32_t chunk_size = read_u32(chunk + 4);
+    size_t body = position + 8;
+
+    if (chunk_is(chunk, "data"))
+    {
+      if (!have_format)
+        return malformed("WAV data chunk comes before the fmt chunk.");
+
+      layout.data_offset = body;
+
+      //Writers that never patched the header leave 0 or 0xFFFFFFFF.
+      if (rf64 && chunk_size == RF64_SIZE_IN_DS64)
+        layout.data_bytes = ds64_data_bytes;
+      else if (chunk_size == 0 || chunk_size == RF64_SIZE_IN_DS64)
+        layout.data_bytes = WAV_DATA_SIZE_UNKNOWN;
+      else
+        layout.data_bytes = chunk_size;
+
+      return 0;
+    }
+
+    //Every other chunk is needed in full before moving past it.
+    if (body + chunk_size > size)
+      return malformed("WAV header is truncated.");
+
+    if (chunk_is(chunk, "ds64"))
+    {
+      if (!rf64 || chunk_size < 24)
+        return malformed("Misplaced or short RF64 ds64 chunk.");
+
+      ds64_data_bytes = read_u64(chunk + 16);
+    }
+    else if (chunk_is(chunk, "fmt "))
+    {
+      int fmt_err = parse_fmt_chunk(chunk + 8, chunk_size, layout.format);
+
+      if (fmt_err < 0)
+        return fmt_err;
+
+      have_format = true;
+    }
+
+    //LIST, fact, bext, JUNK and anything else is skipped. Chunks are
+    //padded to an even length.
+    position = body + chunk_size + (chunk_size & 1);
+  }
+
+  return malformed("WAV header is truncated before the data chunk.");
+}
+
+WavFile::WavFile() :
+  fd(-1),
+  mapping(nullptr),
+  mapping_size(0),
+  layout(),
+  frame_count(0),
+  released_bytes(0)
+{
+}
+
+WavFile::~WavFile()
+{
+  close();
+}
+
+int WavFile::open(const std::string& path)
+{
+  close();
+
+  if ((fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+  {
+    int open_err = errno;
+    handle_error_code(open_err, false, "Cannot open WAV file.");
+    return -open_err;
+  }
+
+  struct stat file_stat;
+
+  if (fstat(fd, &file_stat) < 0 || file_stat.st_size == 0)
+  {
+    close();
+    return malformed("Cannot map an empty WAV file.");
+  }
+
+  mapping_size = file_stat.st_size;
+  void* map = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (map == MAP_FAILED)
+  {
+    int map_err = errno;
+    mapping_size = 0;
+    close();
+    handle_error_code(map_err, false, "Cannot memory-map WAV file.");
+    return -map_err;
+  }
+
+  mapping = static_cast<uint8_t*>(map);
+
+  int parse_err = parse_wav_header(mapping, mapping_size, layout);
+
+  if (parse_err < 0)
+  {
+    close();
+    return parse_err;
+  }
+
+  //A truncated file plays what is there.
+  uint64_t available = mapping_size - layout.data_offset;
+
+  if (layout.data_bytes > available)
+    layout.data_bytes = available;
+
+  frame_count = layout.data_bytes / layout.format.block_align;
+
+  //Playback walks the file once, front to back.
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+
+  return 0;
+}
+
+void WavFile::close()
+{
+  if (mapping != nullptr)
+    munmap(mapping, mapping_size);
+
+  if (fd >= 0)
+    ::close(fd);
+
+  fd = -1;
+  mapping = nullptr;
+  mapping_size = 0;
+  frame_count = 0;
+  released_bytes = 0;
+}
+
+bool WavFile::is_open() const
+{
+  return mapping != nullptr;
+}
+
+const WavFormat& WavFile::format() const
+{
+  return layout.format;
+}
+
+uint64_t WavFile::frames() const
+{
+  return frame_count;
+}
+
+const uint8_t* WavFile::frame_data(uint64_t first_frame) const
+{
+  if (mapping == nullptr || first_frame > frame_count)
+    return nullptr;
+
+  return mapping + layout.data_offset + first_frame * layout.format.block_align;
+}
+
+void WavFile::release(uint64_t up_to_frame)
+{
+  if (mapping == nullptr)
+    return;
+
+  if (up_to_frame > frame_count)
+    up_to_frame = frame_count;
+
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  uint64_t end = (layout.data_offset + up_to_frame * layout.format.block_align) / page_size * page_size;
+
+  if (end <= released_bytes)
+    return;
+
+  madvise(mapping + released_bytes, end - released_bytes, MADV_DONTNEED);
+  released_bytes = end;
+}
@@ -0,0 +1,281 @@
+#include <alsaplusplus/wav_stream.hpp>
+
+#include <chrono>
+
+extern "C"
+{
+#include <fcntl.h>
+#include <sys/stat.h>
+}
+
+using namespace AlsaPlusPlus;
+
+//Far beyond any real fmt or ds64 chunk; guards the allocation against a
+//corrupt size field.
+constexpr uint32_t WAV_STREAM_MAX_HEADER_CHUNK = 64 * 1024;
+
+namespace
+{
+  //Collects what parse_wav_header needs without reading whole chunks it
+  //doesn't: the RIFF header, the fmt and ds64 chunks in full and the data
+  //chunk header. Any other chunk (LIST, cover art, ...) is stepped over with
+  //one pread of its header whatever its size, and kept as an empty chunk so
+  //the parser walks the same list. data_offset is set to where the data
+  //chunk body starts in the file. Returns 0 - a missing or truncated header
+  //is left for parse_wav_header to report - or a negative error code, which
+  //is -EINVAL for a fmt or ds64 chunk too large to be genuine.
+  int read_wav_header(int fd, uint64_t file_size, std::vector<uint8_t>& header, uint64_t& data_offset)
+  {
+    header.resize(file_size < 12 ? file_size : 12);
+    uint64_t position = header.size();
+
+    if (pread(fd, header.data(), header.size(), 0) < 0)
+      return -errno;
+
+    while (position + 8 <= file_size)
+    {
+      size_t chunk_start = header.size();
+      header.resize(chunk_start + 8);
+      uint8_t* chunk = header.data() + chunk_start;
+
+      ssize_t header_read = pread(fd, chunk, 8, position);
+
+      if (header_read < 0)
+        return -errno;
+
+      if (header_read < 8)
+      {
+        header.resize(chunk_start); //File shrank since fstat.
+        return 0;
+      }
+
+      if (memcmp(chunk, "data", 4) == 0)
+      {
+        data_offset = position + 8;
+        return 0;
+      }
+
+      uint32_t chunk_size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | (static_cast<uint32_t>(chunk[7]) << 24);
+      uint64_t padded_size = chunk_size + (chunk_size & 1);
+
+      if (memcmp(chunk, "fmt ", 4) == 0 || memcmp(chunk, "ds64", 4) == 0)
+      {
+        if (chunk_size > WAV_STREAM_MAX_HEADER_CHUNK)
+          return -static_cast<int>(std::errc::invalid_argument);
+
+        header.resize(chunk_start + 8 + padded_size);
+        ssize_t body_read = pread(fd, header.data() + chunk_start + 8, chunk_size, position + 8);
+
+        if (body_read < 0)
+          return -errno;
+
+        if (body_read < chunk_size)
+        {
+          header.resize(chunk_start + 8 + body_read); //Truncated; the parser rejects it.
+          return 0;
+        }
+      }
+      else
+      {
+        memset(chunk + 4, 0, 4);
+      }
+
+      position += 8 + padded_size;
+    }
+
+    return 0;
+  }
+}
+
+WavStreamSource::WavStreamSource() :
+  fd(-1),
+  layout(),
+  frame_count(0),
+  next_frame(0),
+  target_ring(nullptr),
+  running(false),
+  end_of_data(false),
+  read_error(0)
+{
+}
+
+WavStreamSource::~WavStreamSource()
+{
+  close();
+}
+
+int WavStreamSource::open(const std::string& path)
+{
+  close();
+
+  if ((fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+  {
+    int open_err = errno;
+    handle_error_code(open_err, false, "Cannot open WAV file.");
+    return -open_err;
+  }
+
+  struct stat file_stat;
+
+  if (fstat(fd, &file_stat) < 0)
+  {
+    int stat_err = errno;
+    close();
+    handle_error_code(stat_err, false, "Cannot stat WAV file.");
+    return -stat_err;
+  }
+
+  uint64_t file_size = file_stat.st_size;
+  std::vector<uint8_t> header;
+  uint64_t data_offset = 0;
+  int read_err = read_wav_header(fd, file_size, header, data_offset);
+
+  if (read_err < 0)
+  {
+    close();
+    handle_error_code(-read_err, false, "Cannot read WAV header.");
+    return read_err;
+  }
+
+  int parse_err = parse_wav_header(header.data(), header.size(), layout);
+
+  if (parse_err < 0)
+  {
+    close();
+    return parse_err;
+  }
+
+  layout.data_offset = data_offset; //The parser only saw the compacted header.
+
+  uint64_t available = file_size - layout.data_offset;
+
+  if (layout.data_bytes > available)
+    layout.data_bytes = available;
+
+  frame_count = layout.data_bytes / layout.format.block_align;
+  posix_fadvise(fd, layout.data_offset, layout.data_bytes, POSIX_FADV_SEQUENTIAL);
+
+  return 0;
+}
+
+void WavStreamSource::close()
+{
+  stop();
+
+  if (fd >= 0)
+    ::close(fd);
+
+  fd = -1;
+  frame_count = 0;
+}
+
+const WavFormat& WavStreamSource::format() const
+{
+  return layout.format;
+}
+
+uint64_t WavStreamSource::frames() const
+{
+  return frame_count;
+}
+
+int WavStreamSource::start(FrameRingBuffer& ring)
+{
+  if (fd < 0)
+  {
+    handle_error_code(static_cast<int>(std::errc::bad_file_descriptor), false, "No WAV file is open for streaming.");
+    return -static_cast<int>(std::errc::bad_file_descriptor);
+  }
+
+  if (ring.frame_bytes() != layout.format.block_align)
+  {
+    handle_error_code(static_cast<int>(std::errc::invalid_argument), false, "Ring buffer frame size does not match the WAV file.");
+    return -static_cast<int>(std::errc::invalid_argument);
+  }
+
+  stop();
+
+  target_ring = &ring;
+  next_frame = 0;
+  end_of_data = false;
+  read_error = 0;
+  running = true;
+  reader_thread = std::thread(&WavStreamSource::read_loop, this);
+
+  return 0;
+}
+
+void WavStreamSource::stop()
+{
+  running = false;
+
+  if (reader_thread.joinable())
+    reader_thread.join();
+}
+
+bool WavStreamSource::finished() const
+{
+  return end_of_data;
+}
+
+int WavStreamSource::get_error() const
+{
+  return read_error;
+}
+
+//Reads straight into free ring space - no staging buffer - and sleeps
+//half a ring period whenever the ring is full. The consumer never waits on
+//this thread and takes no lock.
+void WavStreamSource::read_loop()
+{
+  size_t block_align = layout.format.block_align;
+  std::chrono::microseconds idle_wait(500000 * target_ring->period_frames() / layout.format.sample_rate_hz);
+
+  if (idle_wait < std::chrono::milliseconds(1))
+    idle_wait = std::chrono::milliseconds(1);
+
+  while (running && next_frame < frame_count)
+  {
+    RingRegion first, second;
+
+    if (target_ring->write_regions(first, second) == 0)
+    {
+      std::this_thread::sleep_for(idle_wait);
+      continue;
+    }
+
+    uint64_t remaining = frame_count - next_frame;
+    size_t frames = (first.frames < remaining) ? first.frames : remaining;
+    off_t offset = layout.data_offset + next_frame * block_align;
+    ssize_t bytes = pread(fd, first.data, frames * block_align, offset);
+
+    if (bytes < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      int data_err = errno;
+      read_error = -data_err;
+      handle_error_code(data_err, false, "Cannot read WAV data.");
+      break;
+    }
+
+    if (bytes == 0)
+      break; //File shrank underneath us.
+
+    //A short read may end mid-frame; that frame is read again next time.
+    size_t frames_read = bytes / block_align;
+
+    if (frames_read > 0)
+    {
+      target_ring->commit_write(frames_read);
+      next_frame += frames_read;
+
+      //Keep the kernel one ring ahead of what is buffered.
+      size_t ring_bytes = target_ring->capacity() * block_align;
+      posix_fadvise(fd, offset + bytes, ring_bytes, POSIX_FADV_WILLNEED);
+    }
+  }
+
+  end_of_data = true;
+}